@@ -1,7 +1,12 @@
 #include "DeserializerStream.hpp"
 #include "Serializable.hpp"
+#include "LazyDeserializer.hpp"
 #include <cstdint>
 #include <cassert>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <exception>
 
 DeserializationException::DeserializationException(DeserializerStream::ErrorType type): type(type){
 	switch (type){
@@ -35,28 +40,90 @@ DeserializationException::DeserializationException(DeserializerStream::ErrorType
 		case DeserializerStream::ErrorType::UnknownEnumValue:
 			this->message = "DeserializationError: The enum's underlying type contains a value not understood by the enum.";
 			break;
+		case DeserializerStream::ErrorType::UniquePtrInArena:
+			this->message = "DeserializationError: Objects owned by an arena, a lazy deserializer or a session can't be owned by an std::unique_ptr.";
+			break;
+		case DeserializerStream::ErrorType::MalformedData:
+			this->message = "DeserializationError: The stream contains encoded data that can't be decoded.";
+			break;
 		default:
 			this->message = "DeserializationError: Unknown.";
 			break;
 	}
 }
 
-DeserializerStream::DeserializerStream(std::istream &stream): stream(&stream){}
+void DeserializationArena::allocate(DeserializerStream &ds, const std::vector<std::pair<std::uint32_t, std::uint32_t>> &type_map){
+	size_t total = 0;
+	size_t max_alignment = 1;
+	std::uint32_t expected_object_id = 1;
+	this->runs.clear();
+	this->runs.reserve(type_map.size());
+	for (auto &[type_id, object_id] : type_map){
+		Run run{ type_id, 0, 0, 0 };
+		if (object_id >= expected_object_id){
+			size_t alignment;
+			this->metadata->get_object_layout(ds, type_id, run.object_size, alignment);
+			run.count = (size_t)object_id - expected_object_id + 1;
+			expected_object_id = object_id + 1;
+			total = (total + alignment - 1) / alignment * alignment;
+			if (run.count > (SIZE_MAX - total - max_alignment) / run.object_size)
+				throw std::bad_alloc();
+			run.offset = total;
+			total += run.count * run.object_size;
+			max_alignment = std::max(max_alignment, alignment);
+		}
+		this->runs.push_back(run);
+	}
+	this->memory.reset(new std::uint8_t[total + max_alignment - 1]);
+	auto p = (uintptr_t)this->memory.get();
+	this->base = this->memory.get() + ((max_alignment - p % max_alignment) % max_alignment);
+}
+
+DeserializationArena::~DeserializationArena(){
+	auto remaining = this->constructed;
+	for (size_t i = 0; i < this->runs.size() && remaining; i++){
+		auto &run = this->runs[i];
+		for (size_t j = 0; j < run.count && remaining; j++, remaining--)
+			this->metadata->destroy_object(run.type, this->get_object(i, j));
+	}
+}
+
+//------------------------------------------------------------------------------
+
+DeserializerStream::DeserializerStream(std::istream &stream): owned_source(new IstreamSource(stream)), source(owned_source.get()){}
+
+DeserializerStream::DeserializerStream(InputSource &source): source(&source){}
+
+DeserializerStream::DeserializerStream(const void *data, size_t size): owned_source(new MemorySource(data, size)), source(owned_source.get()){}
+
+DeserializerStream::~DeserializerStream(){
+	if (!this->session_metadata)
+		return;
+	//In the reverse order of construction.
+	for (auto i = this->slots.size(); i-- > 1;){
+		auto &slot = this->slots[i];
+		this->session_metadata->destroy_object(slot.type, slot.address);
+		::operator delete(slot.address);
+	}
+}
 
 void DeserializerStream::report_error(ErrorType type){
 	throw DeserializationException(type);
 }
 
-std::vector<std::pair<std::uint32_t, TypeHash> > DeserializerStream::read_typehashes(){
-	std::vector<std::pair<std::uint32_t, TypeHash> > ret;
+std::unordered_map<std::uint32_t, std::uint32_t> DeserializerStream::read_typehashes(const SerializableMetadata &metadata){
+	std::unordered_map<std::uint32_t, std::uint32_t> ret;
 	std::uint32_t size;
 	this->deserialize(size);
-	ret.reserve(size);
-	while (ret.size() < size){
-		std::pair<std::uint32_t, TypeHash> pair;
-		this->deserialize(pair.first);
-		this->deserialize_array(pair.second.digest);
-		ret.push_back(pair);
+	ret.reserve(next_chunk<std::pair<const std::uint32_t, std::uint32_t>>(0, size));
+	while (size--){
+		std::uint32_t type_id;
+		TypeHash hash;
+		this->deserialize(type_id);
+		this->deserialize_array(hash.digest);
+		auto known_type = metadata.known_type_from_hash(hash);
+		if (known_type)
+			ret[type_id] = known_type;
 	}
 	return ret;
 }
@@ -83,46 +150,165 @@ It find_first_true(It begin, It end, const F &f){
 	return end;
 }
 
-std::unique_ptr<Serializable> DeserializerStream::perform_deserialization(SerializableMetadata &metadata, const Options &options){
-	this->metadata = &metadata;
-	auto &object_types = this->object_types;
-	object_types.clear();
-	std::vector<std::pair<std::uint32_t, void *> > initialized;
-	void *main_object = nullptr;
-	try{
-		this->state = State::Safe;
-		this->state = State::ReadingTypeHashes;
-		if (options.includes_typehashes){
+bool DeserializerStream::read_header(const SerializableMetadata &metadata, const Options &options, std::vector<std::pair<std::uint32_t, objectid_t>> &type_map, objectid_t &root_object_id){
+	this->wire_format = options.wire_format;
+	this->state = State::Safe;
+	this->state = State::ReadingTypeHashes;
+	std::unordered_map<std::uint32_t, std::uint32_t> typehash_map;
+	if (options.includes_typehashes){
 #ifdef LOG
-			std::clog << "Reading type hashes...\n";
+		std::clog << "Reading type hashes...\n";
 #endif
-			metadata.set_type_mappings(this->read_typehashes());
-		}
-		this->state = State::Safe;
+		typehash_map = this->read_typehashes(metadata);
+	}
+	this->state = State::Safe;
 
 #ifdef LOG
-		std::clog << "Reading node map...\n";
+	std::clog << "Reading node map...\n";
 #endif
-		std::vector<std::pair<std::uint32_t, objectid_t>> type_map;
-		wire_size_t size;
-		this->deserialize(size);
-		type_map.reserve((size_t)size);
-		while (size--){
-			std::uint32_t type_id;
-			objectid_t object_id;
-			this->deserialize(type_id);
-			this->deserialize(object_id);
-			if (options.type_map){
-				auto it = options.type_map->find(type_id);
-				if (it == options.type_map->end())
-					return {};
-				type_id = it->second;
-			}
-			type_map.push_back(std::make_pair(type_id, object_id));
+	wire_size_t size;
+	this->deserialize(size);
+	type_map.reserve((size_t)size);
+	while (size--){
+		std::uint32_t type_id;
+		objectid_t object_id;
+		this->deserialize(type_id);
+		this->deserialize(object_id);
+		//The type hashes are keyed by the IDs on the wire, like the node map,
+		//so they take precedence over type_map.
+		if (options.includes_typehashes){
+			auto it = typehash_map.find(type_id);
+			if (it == typehash_map.end())
+				this->report_error(ErrorType::AllocateObjectOfUnknownType);
+			type_id = it->second;
+		}else if (options.type_map){
+			auto it = options.type_map->find(type_id);
+			if (it == options.type_map->end())
+				return false;
+			type_id = it->second;
 		}
+		type_map.push_back(std::make_pair(type_id, object_id));
+	}
+
+	this->deserialize(root_object_id);
+	return true;
+}
 
+DeserializerStream::objectid_t DeserializerStream::count_objects(const std::vector<std::pair<std::uint32_t, objectid_t>> &type_map){
+	objectid_t ret = 0;
+	for (auto &[type_id, object_id] : type_map)
+		ret = std::max(ret, object_id);
+	return ret;
+}
+
+//Deleter of the control block shared by every std::shared_ptr to an object.
+//It destroys the object as its own type, whatever the type of the pointers.
+class DeserializerStream::ObjectDeleter{
+	SerializableMetadata::destructor_t destructor;
+	std::uint32_t type;
+	bool enabled = false;
+public:
+	ObjectDeleter(SerializableMetadata::destructor_t destructor, std::uint32_t type): destructor(destructor), type(type){}
+	void enable(){
+		this->enabled = true;
+	}
+	void disable(){
+		this->enabled = false;
+	}
+	void operator()(void *p) const{
+		if (!this->enabled)
+			return;
+		this->destructor(this->type, p);
+		::operator delete(p);
+	}
+};
+
+void DeserializerStream::set_backpatched_pointers(){
+	for (auto &p : this->pointers)
+		p.callback(*this, p.dst, p.object_id);
+	this->pointers.clear();
+}
+
+//Leaves the objects to whoever is cleaning up after a failed deserialization.
+void DeserializerStream::release_owners(objectid_t first_object){
+	for (auto i = (size_t)first_object; i < this->slots.size(); i++){
+		auto &slot = this->slots[i];
+		if (slot.owner)
+			std::get_deleter<ObjectDeleter>(slot.owner)->disable();
+		slot.owner.reset();
+	}
+}
+
+void DeserializerStream::claim_object(objectid_t oid, PointerType pointer_type){
+	if (this->parent){
+		std::lock_guard<std::mutex> lock(this->parent->parent_mutex);
+		this->parent->claim_object(oid, pointer_type);
+		return;
+	}
+	//It's an error for an std::unique_ptr and an std::shared_ptr to point to
+	//the same object, or for two std::unique_ptrs to.
+	auto &slot = this->get_slot(oid);
+	if (slot.pointer_type == PointerType::RawPointer)
+		slot.pointer_type = pointer_type;
+	else if (slot.pointer_type != pointer_type || pointer_type == PointerType::UniquePtr)
+		this->report_error(ErrorType::InconsistentSmartPointers);
+}
+
+const std::shared_ptr<void> &DeserializerStream::get_owner(objectid_t oid){
+	if (this->parent){
+		std::lock_guard<std::mutex> lock(this->parent->parent_mutex);
+		return this->parent->get_owner(oid);
+	}
+	auto &slot = this->get_slot(oid);
+	if (!slot.owner){
+		//The deleter is only enabled once the control block exists, since
+		//std::shared_ptr would otherwise destroy the object if it failed to
+		//allocate it.
+		slot.owner = std::shared_ptr<void>(
+			this->get_object_address(oid),
+			ObjectDeleter(this->metadata->get_destructor(), this->get_object_type(oid))
+		);
+		//The objects are owned by the arena or the lazy deserializer, not by
+		//the smart pointers.
+		if (!this->owns_objects_externally())
+			std::get_deleter<ObjectDeleter>(slot.owner)->enable();
+	}
+	return slot.owner;
+}
+
+Serializable *DeserializerStream::get_serializable(objectid_t oid){
+	return this->metadata->perform_dynamic_cast(this->get_object_address(oid), this->get_object_type(oid));
+}
+
+std::unique_ptr<Serializable> DeserializerStream::perform_deserialization(const SerializableMetadata &metadata, const Options &options){
+	this->metadata = &metadata;
+	std::vector<std::pair<std::uint32_t, void *> > initialized;
+	void *main_object = nullptr;
+	//In a session, the objects of earlier messages, which keep their slots.
+	const auto base = this->session_metadata && this->slots.size() ? (objectid_t)(this->slots.size() - 1) : 0;
+	try{
+		std::vector<std::pair<std::uint32_t, objectid_t>> type_map;
 		objectid_t root_object_id;
-		this->deserialize(root_object_id);
+		if (!this->read_header(metadata, options, type_map, root_object_id))
+			return {};
+		this->pointers.clear();
+		auto object_count = std::max(count_objects(type_map), base);
+		if (!base)
+			this->slots.clear();
+		this->slots.resize((size_t)object_count + 1);
+		std::vector<std::uint64_t> offsets;
+		if (options.includes_offset_table){
+			//Only needed to split the work between threads.
+			auto parallel = options.decoding_threads > 1;
+			if (parallel)
+				offsets.reserve((size_t)(object_count - base) + 1);
+			for (objectid_t i = base; i <= object_count; i++){
+				std::uint64_t offset;
+				this->deserialize_fixed(offset);
+				if (parallel)
+					offsets.push_back(offset);
+			}
+		}
 
 #ifdef LOG
 		std::clog << "Allocating memory...\n";
@@ -130,25 +316,34 @@ std::unique_ptr<Serializable> DeserializerStream::perform_deserialization(Serial
 		this->state = State::AllocatingMemory;
 		std::uint32_t main_object_type = 0;
 		{
-			objectid_t expected_object_id = 1;
+			if (this->arena)
+				this->arena->allocate(*this, type_map);
+			objectid_t expected_object_id = base + 1;
+			size_t run = 0;
 			for (auto &[type_id, object_id] : type_map){
-				for (; expected_object_id <= object_id; expected_object_id++){
-					object_types[expected_object_id] = type_id;
-					auto mem = metadata.allocate_memory(*this, type_id);
-					if (!mem)
-						this->report_error(ErrorType::AllocateAbstractObject);
+				for (size_t index = 0; expected_object_id <= object_id; expected_object_id++){
+					void *mem;
+					if (this->arena)
+						mem = this->arena->get_object(run, index++);
+					else{
+						mem = metadata.allocate_memory(*this, type_id);
+						if (!mem)
+							this->report_error(ErrorType::AllocateAbstractObject);
+					}
 
 					if (!main_object && expected_object_id == root_object_id){
 						main_object = mem;
 						main_object_type = type_id;
 					}
-					try{
-						this->node_map[expected_object_id] = mem;
-					}catch (...){
-						::operator delete(mem);
-						throw;
-					}
+					auto &slot = this->slots[expected_object_id];
+					slot.address = mem;
+					slot.type = type_id;
 				}
+				run++;
+			}
+			if (!main_object && root_object_id && root_object_id <= base){
+				main_object = this->slots[root_object_id].address;
+				main_object_type = this->slots[root_object_id].type;
 			}
 		}
 
@@ -156,10 +351,15 @@ std::unique_ptr<Serializable> DeserializerStream::perform_deserialization(Serial
 		std::clog << "Constructing memory (by deserializing object data)...\n";
 #endif
 		this->state = State::InitializingObjects;
-		for (auto &kv : this->node_map){
-			auto type = object_types[kv.first];
-			metadata.construct_memory(type, kv.second, *this);
-			initialized.push_back(std::make_pair(type, kv.second));
+		if (offsets.size() > 1)
+			this->construct_objects_parallel(metadata, base, offsets, options.decoding_threads, initialized);
+		else{
+			initialized.reserve((size_t)(object_count - base));
+			for (objectid_t oid = base + 1; oid <= object_count; oid++){
+				auto &slot = this->slots[oid];
+				metadata.construct_memory(slot.type, slot.address, *this);
+				initialized.push_back(std::make_pair(slot.type, slot.address));
+			}
 		}
 #ifdef LOG
 		std::clog << "Checking sanity...\n";
@@ -171,63 +371,23 @@ std::unique_ptr<Serializable> DeserializerStream::perform_deserialization(Serial
 		//Check that the main object is an instance of Serializable.
 		if (!metadata.type_is_serializable(main_object_type))
 			this->report_error(ErrorType::MainObjectNotSerializable);
-		//Check smart pointer consistency. In particular, it's an error for an
-		//std::unique_ptr and an std::shared_ptr to point to the same object.
-		try{
-			std::map<objectid_t, PointerType> pointer_types;
-			for (auto &p : this->pointers){
-				auto it = pointer_types.find(p.object_id);
-				if (it == pointer_types.end()){
-					pointer_types[p.object_id] = p.pointer_type;
-					continue;
-				}
-				switch (it->second){
-					case PointerType::RawPointer:
-						it->second = p.pointer_type;
-						break;
-					case PointerType::UniquePtr:
-						if (p.pointer_type == PointerType::SharedPtr)
-							this->report_error(ErrorType::InconsistentSmartPointers);
-						break;
-					case PointerType::SharedPtr:
-						if (p.pointer_type == PointerType::UniquePtr)
-							this->report_error(ErrorType::InconsistentSmartPointers);
-						break;
-					default:
-						throw InternalErrorException();
-				}
-			}
-		}catch (std::bad_alloc &){
-#ifdef LOG
-			std::clog << "Allocation error while checking sanity. Continuing anyway...\n";
-#endif
-		}
+		//Smart pointer consistency was checked as the pointers were read.
 		main_object = metadata.perform_dynamic_cast(main_object, main_object_type);
 		this->state = State::SettingPointers;
 #ifdef LOG
 		std::clog << "Setting pointers...\n";
 #endif
-		{
-			try{
-				for (auto &p : this->pointers){
-					K key(p.object_id, p.pointer_type);
-					if (this->base_pointers.find(key) != this->base_pointers.end())
-						continue;
-					this->base_pointers[key] = metadata.allocate_pointer(p.object_type, p.pointer_type, this->node_map[p.object_id]);
-				}
-				for (auto &p : this->pointers){
-					K key(p.object_id, p.pointer_type);
-					auto temp = this->base_pointers[key]->cast(p.pointed_type);
-					p.setter(temp->pointer);
-				}
-				this->base_pointers.clear();
-			}catch (std::bad_alloc &){
-				for (auto &kv : this->base_pointers)
-					kv.second->release();
-				this->report_error(ErrorType::OutOfMemory);
-			}
+		try{
+			this->set_backpatched_pointers();
+		}catch (std::bad_alloc &){
+			this->report_error(ErrorType::OutOfMemory);
 		}
+		if (!this->session_metadata)
+			this->slots.clear();
 		this->state = State::Done;
+		if (this->arena)
+			this->arena->constructed = initialized.size();
+		this->source->sync();
 	}catch (std::bad_alloc &){
 		throw;
 	}catch (std::exception &){
@@ -240,14 +400,16 @@ std::unique_ptr<Serializable> DeserializerStream::perform_deserialization(Serial
 			case State::SanityCheck:
 			case State::InitializingObjects:
 				for (auto &p : initialized)
-					metadata.rollback_construction(object_types[p.first], p.second);
-				for (auto &[k, p] : this->base_pointers)
-					p->release();
-				this->base_pointers.clear();
+					metadata.rollback_construction(p.first, p.second);
+				this->release_owners(base + 1);
+				this->pointers.clear();
 			case State::AllocatingMemory:
-				for (auto &pair : this->node_map)
-					::operator delete(pair.second);
-				this->node_map.clear();
+				//Arena memory is released with the arena.
+				if (!this->arena)
+					for (auto i = (size_t)base + 1; i < this->slots.size(); i++)
+						::operator delete(this->slots[i].address);
+				//The objects of earlier messages of the session are kept.
+				this->slots.resize(base ? (size_t)base + 1 : 0);
 				break;
 			case State::Done:
 				assert(false);
@@ -260,15 +422,140 @@ std::unique_ptr<Serializable> DeserializerStream::perform_deserialization(Serial
 	return std::unique_ptr<Serializable>((Serializable *)main_object);
 }
 
-int DeserializerStream::categorize_cast(std::uint32_t object_type, std::uint32_t dst_type){
-	return (int)this->metadata->categorize_cast(object_type, dst_type);
+CastCategory DeserializerStream::categorize_cast(std::uint32_t object_type, std::uint32_t dst_type, std::ptrdiff_t &offset){
+	return this->metadata->categorize_cast(object_type, dst_type, offset);
+}
+
+//offsets[i] is the offset of object base + i + 1.
+void DeserializerStream::construct_objects_parallel(const SerializableMetadata &metadata, objectid_t base, const std::vector<std::uint64_t> &offsets, unsigned threads, std::vector<std::pair<std::uint32_t, void *>> &initialized){
+	auto object_count = (objectid_t)(offsets.size() - 1);
+	auto size = offsets.back();
+	for (objectid_t i = 0; i < object_count; i++)
+		if (offsets[i] > offsets[i + 1])
+			this->report_error(ErrorType::UnexpectedEndOfFile);
+	if (size > SIZE_MAX || !this->source->ensure((size_t)size))
+		this->report_error(ErrorType::UnexpectedEndOfFile);
+	auto data = this->source->data();
+
+	struct Worker{
+		objectid_t first;
+		objectid_t last;
+		objectid_t constructed = 0;
+		std::vector<PointerBackpatch> pointers;
+		std::exception_ptr error;
+	};
+
+	//Split the objects into ranges of roughly the same size in bytes.
+	threads = std::min<unsigned>(threads, object_count);
+	std::vector<Worker> workers(threads);
+	{
+		objectid_t oid = 1;
+		for (unsigned i = 0; i < threads; i++){
+			auto &w = workers[i];
+			w.first = oid;
+			auto limit = size / threads * (i + 1);
+			while (oid <= object_count && (i == threads - 1 || offsets[oid - 1] < limit))
+				oid++;
+			w.last = oid - 1;
+		}
+	}
+
+	//The workers count objects from 1, like offsets.
+	auto work = [this, &metadata, &offsets, data, base](Worker &w){
+		try{
+			if (w.first > w.last)
+				return;
+			auto begin = offsets[w.first - 1];
+			MemorySource source(data + begin, (size_t)(offsets[w.last] - begin), this->source->get_owner());
+			DeserializerStream ds(source);
+			ds.metadata = &metadata;
+			ds.wire_format = this->wire_format;
+			ds.parent = this;
+			ds.arena = this->arena;
+			for (auto oid = base + w.first; oid <= base + w.last; oid++, w.constructed++)
+				metadata.construct_memory(this->slots[oid].type, this->slots[oid].address, ds);
+			w.pointers = std::move(ds.pointers);
+		}catch (...){
+			w.error = std::current_exception();
+		}
+	};
+
+	{
+		std::vector<std::thread> pool;
+		try{
+			pool.reserve(threads - 1);
+			for (unsigned i = 1; i < threads; i++)
+				pool.emplace_back(work, std::ref(workers[i]));
+		}catch (...){
+			//Couldn't start all the threads. Do the rest of the work here.
+			for (auto i = pool.size() + 1; i < threads; i++)
+				work(workers[i]);
+		}
+		work(workers[0]);
+		for (auto &t : pool)
+			t.join();
+	}
+
+	for (auto &w : workers){
+		for (objectid_t i = 0; i < w.constructed; i++){
+			auto &slot = this->slots[base + w.first + i];
+			initialized.push_back(std::make_pair(slot.type, slot.address));
+		}
+	}
+	for (auto &w : workers){
+		if (!w.error)
+			continue;
+		try{
+			std::rethrow_exception(w.error);
+		}catch (DeserializationException &e){
+			this->report_error(e.get_type());
+		}
+	}
+	for (auto &w : workers)
+		this->pointers.insert(this->pointers.end(), w.pointers.begin(), w.pointers.end());
+	this->source->advance((size_t)size);
+}
+
+void DeserializerStream::run_batch(size_t count, unsigned threads, const std::function<void(size_t)> &f){
+	threads = (unsigned)std::max<size_t>(std::min<size_t>(threads, count), 1);
+	std::atomic<size_t> next(0);
+	auto work = [&](){
+		for (size_t i; (i = next++) < count;)
+			f(i);
+	};
+	std::vector<std::thread> pool;
+	try{
+		pool.reserve(threads - 1);
+		for (unsigned i = 1; i < threads; i++)
+			pool.emplace_back(work);
+	}catch (...){
+		//Couldn't start all the threads. The ones that did start and this one
+		//will do all the work.
+	}
+	work();
+	for (auto &t : pool)
+		t.join();
+}
+
+//Near the end of the input, where a full 8 byte load might not be possible.
+std::uint64_t DeserializerStream::deserialize_prefix_varint_slow(){
+	if (!this->source->ensure(1))
+		this->report_error(ErrorType::UnexpectedEndOfFile);
+	auto length = prefix_varint::length_from_first_byte(*this->source->data());
+	if (!this->source->ensure(length))
+		this->report_error(ErrorType::UnexpectedEndOfFile);
+	auto ret = prefix_varint::decode(this->source->data(), length);
+	this->source->advance(length);
+	return ret;
 }
 
-std::unique_ptr<GenericPointer> DeserializerStream::allocate_pointer(std::uint32_t object_type, PointerType pointer_type, objectid_t object){
-	return this->metadata->allocate_pointer(object_type, pointer_type, this->node_map[object]);
+void DeserializerStream::require_object(objectid_t oid){
+	this->lazy->require(oid);
 }
 
-void DeserializerStream::set_pointer(void *dst, PointerBackpatch::Setter::callback_t callback, GenericPointer &gp, std::uint32_t pointed_type){
-	auto temp = gp.cast(pointed_type);
-	callback(dst, temp->pointer);
+DeserializerStream::ObjectSlot &DeserializerStream::get_lazy_slot(objectid_t oid){
+	auto it = this->lazy->slots.find(oid);
+	if (it == this->lazy->slots.end())
+		this->report_error(ErrorType::UnknownObjectId);
+	return it->second;
 }
@@ -11,12 +11,20 @@
 #include <unordered_map>
 #include <cstdint>
 #include <array>
+#include <algorithm>
+#include <mutex>
+#include <functional>
+#include <exception>
 #if __cplusplus >= 201703
 #define SERIALIZATION_HAVE_STD_OPTIONAL
 #include <optional>
 #endif
 #include "Serializable.hpp"
 #include "serialization_utils.hpp"
+#include "InputSource.hpp"
+#include "varint.hpp"
+#include "block_codec.hpp"
+#include "gorilla.hpp"
 
 class Serializable;
 struct TypeHash;
@@ -28,11 +36,39 @@ enum class PointerType{
 	SharedPtr,
 };
 
-class GenericPointer;
+class DeserializerStream;
+class LazyDeserializer;
 
-template <typename T>
-void set_pointer(void *dst, void *p){
-	*(T *)dst = std::move(*(T *)p);
+//Owns every object of a graph deserialized by
+//DeserializerStream::full_deserialization_arena(). The objects are placed in a
+//single block of memory, with each run of same-typed objects from the node map
+//stored back to back. Destroying the arena destroys all the objects and
+//releases the block in one go.
+class DeserializationArena{
+	friend class DeserializerStream;
+	struct Run{
+		std::uint32_t type;
+		size_t offset;
+		size_t object_size;
+		size_t count;
+	};
+	std::shared_ptr<const SerializableMetadata> metadata;
+	std::unique_ptr<std::uint8_t[]> memory;
+	std::uint8_t *base = nullptr;
+	std::vector<Run> runs;
+	//Number of objects, in object ID order, that need to be destroyed.
+	size_t constructed = 0;
+
+	void allocate(DeserializerStream &, const std::vector<std::pair<std::uint32_t, std::uint32_t>> &type_map);
+	void *get_object(size_t run, size_t index) const{
+		auto &r = this->runs[run];
+		return this->base + r.offset + index * r.object_size;
+	}
+public:
+	DeserializationArena(std::shared_ptr<const SerializableMetadata> metadata): metadata(std::move(metadata)){}
+	DeserializationArena(const DeserializationArena &) = delete;
+	DeserializationArena &operator=(const DeserializationArena &) = delete;
+	~DeserializationArena();
 };
 
 class DeserializerStream{
@@ -48,36 +84,48 @@ public:
 		InvalidCast,
 		OutOfMemory,
 		UnknownEnumValue,
+		UniquePtrInArena,
+		MalformedData,
 	};
 	class Options{
 	public:
 		bool includes_typehashes = false;
 		//protocol type ID -> native type ID
-		std::unordered_map<std::uint32_t, std::uint32_t> *type_map = nullptr;
+		const std::unordered_map<std::uint32_t, std::uint32_t> *type_map = nullptr;
+		bool includes_offset_table = false;
+		//Object bodies are decoded on this many threads. Has no effect unless
+		//the message includes an offset table.
+		unsigned decoding_threads = 1;
+		//A combination of wire_flags.
+		std::uint32_t wire_format = 0;
 	};
 private:
 	typedef std::uint32_t objectid_t;
 	
+	//A pointer that can't be set until every object has been constructed.
 	struct PointerBackpatch{
-		std::uint32_t pointed_type;
-		std::uint32_t object_type;
+		typedef void (*callback_t)(DeserializerStream &, void *dst, objectid_t);
+		void *dst;
+		callback_t callback;
 		objectid_t object_id;
-		PointerType pointer_type;
-		struct Setter{
-			typedef void (*callback_t)(void *dst, void *p);
-			void *dst;
-			callback_t callback;
-			void operator()(void *p) const{
-				this->callback(this->dst, p);
-			}
-		};
-		Setter setter;
 	};
+	//Everything known about an object, indexed by object ID.
+	struct ObjectSlot{
+		//Null until the object is allocated.
+		void *address = nullptr;
+		std::uint32_t type = 0;
+		//Control block shared by every std::shared_ptr to the object. Created
+		//along with the first one.
+		std::shared_ptr<void> owner;
+		//RawPointer until a smart pointer to the object is seen.
+		PointerType pointer_type = PointerType::RawPointer;
+	};
+	class ObjectDeleter;
 
-	std::istream *stream;
-	std::map<objectid_t, void *> node_map;
-	std::map<objectid_t, std::uint32_t> object_types;
-	std::vector<std::pair<std::uint32_t, TypeHash>> read_typehashes();
+	std::unique_ptr<InputSource> owned_source;
+	InputSource *source;
+	//Maps the type IDs of the sender to the known types with the same hashes.
+	std::unordered_map<std::uint32_t, std::uint32_t> read_typehashes(const SerializableMetadata &);
 	enum class State{
 		Safe,
 		ReadingTypeHashes,
@@ -89,15 +137,125 @@ private:
 	};
 	State state;
 	std::vector<PointerBackpatch> pointers;
-	SerializableMetadata *metadata;
-	typedef std::pair<objectid_t, PointerType> K;
-	typedef std::unique_ptr<GenericPointer> V;
-	std::map<K, V> base_pointers;
+	std::vector<ObjectSlot> slots;
+	const SerializableMetadata *metadata;
+	//Options::wire_format of the current message.
+	std::uint32_t wire_format = 0;
+	//Set only during full_deserialization_arena().
+	DeserializationArena *arena = nullptr;
+	//Set only while a LazyDeserializer is decoding objects.
+	LazyDeserializer *lazy = nullptr;
+	//Set by the first full_deserialization_session(). The objects of every
+	//message of the session stay in slots, and the stream owns them.
+	std::shared_ptr<const SerializableMetadata> session_metadata;
+	//Set on the streams that decode object bodies in parallel. They look up
+	//objects in the parent and set smart pointers through it.
+	DeserializerStream *parent = nullptr;
+	std::mutex parent_mutex;
 
-	std::unique_ptr<Serializable> perform_deserialization(SerializableMetadata &, const Options &);
-	int categorize_cast(std::uint32_t object_type, std::uint32_t dst_type);
-	std::unique_ptr<GenericPointer> allocate_pointer(std::uint32_t object_type, PointerType pointer_type, objectid_t object);
-	void set_pointer(void *pointer, PointerBackpatch::Setter::callback_t callback, GenericPointer &gp, std::uint32_t pointed_type);
+	friend class LazyDeserializer;
+	bool owns_objects_externally() const{
+		return this->arena || this->lazy || this->session_metadata || (this->parent && this->parent->owns_objects_externally());
+	}
+	bool read_header(const SerializableMetadata &, const Options &, std::vector<std::pair<std::uint32_t, objectid_t>> &type_map, objectid_t &root_object_id);
+	static objectid_t count_objects(const std::vector<std::pair<std::uint32_t, objectid_t>> &type_map);
+	void set_backpatched_pointers();
+	void release_owners(objectid_t first_object);
+	void claim_object(objectid_t, PointerType);
+	const std::shared_ptr<void> &get_owner(objectid_t);
+	Serializable *get_serializable(objectid_t);
+	void construct_objects_parallel(const SerializableMetadata &, objectid_t base, const std::vector<std::uint64_t> &offsets, unsigned threads, std::vector<std::pair<std::uint32_t, void *>> &initialized);
+	//Calls f with every index in [0; count), on up to this many threads.
+	static void run_batch(size_t count, unsigned threads, const std::function<void(size_t)> &f);
+	void require_object(objectid_t);
+	//Lengths come straight from the input, so containers are grown as their
+	//elements are read rather than allocated up front. The first chunk is at
+	//most max_preallocation bytes, and every later one at most doubles the
+	//container, so corrupt input hits EOF before it can force allocations
+	//much larger than itself.
+	static const size_t max_preallocation = 1 << 16;
+	template <typename T>
+	static size_t next_chunk(size_t read, wire_size_t size){
+		auto limit = std::max<size_t>({ read, max_preallocation / sizeof(T), 1 });
+		return (size_t)std::min<wire_size_t>(size - read, limit);
+	}
+	//Reads a block-coded vector or string.
+	template <typename Container>
+	void deserialize_block(Container &c){
+		typedef typename Container::value_type T;
+		wire_size_t size;
+		this->deserialize(size);
+		if (size > SIZE_MAX / sizeof(T))
+			this->report_error(ErrorType::UnexpectedEndOfFile);
+		auto n = (size_t)size;
+		auto control_size = block_codec::control_size<T>(n);
+		if (!this->source->ensure(control_size))
+			this->report_error(ErrorType::UnexpectedEndOfFile);
+		auto data_size = block_codec::data_size<T>(this->source->data(), n);
+		if (!this->source->ensure(control_size + data_size))
+			this->report_error(ErrorType::UnexpectedEndOfFile);
+		c.resize(n);
+		auto control = this->source->data();
+		block_codec::decode(control, control + control_size, data_size, n, c.data());
+		this->source->advance(control_size + data_size);
+	}
+	std::uint64_t deserialize_prefix_varint_slow();
+	std::uint64_t deserialize_prefix_varint(){
+		if (this->source->available() >= prefix_varint::max_length){
+			unsigned length;
+			auto ret = prefix_varint::decode_fast(this->source->data(), length);
+			this->source->advance(length);
+			return ret;
+		}
+		return this->deserialize_prefix_varint_slow();
+	}
+	//While a LazyDeserializer is decoding, the slots are kept by it instead.
+	ObjectSlot &get_lazy_slot(objectid_t);
+	ObjectSlot &get_slot(objectid_t oid){
+		if (this->lazy)
+			return this->get_lazy_slot(oid);
+		return this->slots[oid];
+	}
+	const ObjectSlot &get_object(objectid_t oid){
+		if (this->lazy)
+			return this->get_lazy_slot(oid);
+		auto &slots = this->parent ? this->parent->slots : this->slots;
+		if (oid >= slots.size() || !slots[oid].address)
+			this->report_error(ErrorType::UnknownObjectId);
+		return slots[oid];
+	}
+	std::uint32_t get_object_type(objectid_t oid){
+		return this->get_object(oid).type;
+	}
+	void *get_object_address(objectid_t oid){
+		return this->get_object(oid).address;
+	}
+	std::unique_ptr<Serializable> perform_deserialization(const SerializableMetadata &, const Options &);
+	CastCategory categorize_cast(std::uint32_t object_type, std::uint32_t dst_type, std::ptrdiff_t &offset);
+	//The pointers are built in place, straight from the object's address.
+	template <typename T>
+	void assign_pointer(T *&t, T *p, objectid_t){
+		t = p;
+	}
+	template <typename T>
+	void assign_pointer(std::unique_ptr<T> &t, T *p, objectid_t){
+		t.reset(p);
+	}
+	template <typename T>
+	void assign_pointer(std::shared_ptr<T> &t, T *p, objectid_t oid){
+		t = std::shared_ptr<T>(this->get_owner(oid), p);
+	}
+	//Complex casts need to read the object's virtual base offsets, so they're
+	//performed once every object has been constructed.
+	template <typename T, typename T2>
+	static void set_backpatched_pointer(DeserializerStream &ds, void *dst, objectid_t oid){
+		T2 *p = nullptr;
+		if constexpr (std::is_polymorphic_v<T2>)
+			p = dynamic_cast<T2 *>(ds.get_serializable(oid));
+		if (!p)
+			ds.report_error(ErrorType::InvalidCast);
+		ds.assign_pointer(*(T *)dst, p, oid);
+	}
 	template <typename T, typename T2>
 	void deserialize_ptr(T &t, PointerType pointer_type){
 		objectid_t oid;
@@ -106,56 +264,77 @@ private:
 			t = nullptr;
 			return;
 		}
-		auto object_type = this->object_types[oid];
+		if (pointer_type == PointerType::UniquePtr && this->owns_objects_externally())
+			this->report_error(ErrorType::UniquePtrInArena);
+		if (this->lazy)
+			this->require_object(oid);
+		auto &object = this->get_object(oid);
+		if (pointer_type != PointerType::RawPointer)
+			this->claim_object(oid, pointer_type);
 		auto dst_type = static_get_type_id<T2>::value;
-		switch (dst_type == object_type ? 0 : this->categorize_cast(object_type, dst_type)){
-			case 0:
-				{
-					K key(oid, pointer_type);
-					GenericPointer *gp = nullptr;
-					auto found = this->base_pointers.find(key);
-					if (found == this->base_pointers.end()){
-						auto temp = this->allocate_pointer(object_type, pointer_type, oid);
-						if (pointer_type == PointerType::UniquePtr){
-							::set_pointer<T>(&t, temp->pointer);
-							this->base_pointers[key] = {};
-						}else{
-							gp = temp.get();
-							this->base_pointers[key] = std::move(temp);
-						}
-					}else{
-						gp = found->second.get();
-						if (!gp)
-							throw std::runtime_error("Multiple unique pointers to single object detected. (Is this correct?)");
-					}
-					if (gp)
-						this->set_pointer(&t, &::set_pointer<T>, *gp, dst_type);
-				}
-				return;
-			case 1:
-				break;
-			default:
-				this->report_error(ErrorType::InvalidCast);
+		std::ptrdiff_t offset = 0;
+		if (dst_type != object.type){
+			switch (this->categorize_cast(object.type, dst_type, offset)){
+				case CastCategory::Trivial:
+					break;
+				case CastCategory::Complex:
+					this->pointers.push_back({ &t, &set_backpatched_pointer<T, T2>, oid });
+					return;
+				default:
+					this->report_error(ErrorType::InvalidCast);
+			}
 		}
-		PointerBackpatch pb;
-		pb.pointed_type = dst_type;
-		pb.object_type = object_type;
-		pb.object_id = oid;
-		pb.pointer_type = pointer_type;
-		pb.setter.dst = &t;
-		pb.setter.callback = &::set_pointer<T>;
-		this->pointers.push_back(pb);
+		//Same type, or a non-virtual base at a known offset.
+		this->assign_pointer(t, (T2 *)((char *)object.address + offset), oid);
 	}
 
+	//Reads what SerializerStream::serialize_key_deltas() writes. Every
+	//element goes at the end, so the container is built in linear time.
+	template <typename Container>
+	void deserialize_key_deltas(Container &c, size_t size){
+		typedef typename Container::key_type K;
+		const K *previous = nullptr;
+		for (size_t i = 0; i < size; i++){
+			K key = 0;
+			if (previous){
+				typename std::make_unsigned<K>::type gap = 0;
+				this->deserialize(gap);
+				if (!ordered_key_after(*previous, gap, key))
+					this->report_error(ErrorType::MalformedData);
+			}else
+				this->deserialize(key);
+			if constexpr (is_maplike<Container>::value){
+				typedef typename Container::mapped_type V;
+				typename Container::iterator it;
+				if constexpr (is_serializable<V>::value)
+					it = c.emplace_hint(c.end(), std::pair<K &, decltype(*this) &>(key, *this));
+				else{
+					V value;
+					this->deserialize(value);
+					it = c.emplace_hint(c.end(), key, std::move(value));
+				}
+				previous = &it->first;
+			}else
+				previous = &*c.emplace_hint(c.end(), key);
+		}
+	}
 	template <typename SetT, typename ValueT>
 	typename std::enable_if<is_simply_constructible<ValueT>::value, void>::type deserialize_setlike(SetT &s){
 		s.clear();
 		wire_size_t size;
 		this->deserialize(size);
+		if constexpr (is_ordered_container<SetT>::value && is_delta_key<ValueT>::value){
+			if (this->wire_format & wire_flags::sorted_key_deltas){
+				this->deserialize_key_deltas(s, (size_t)size);
+				return;
+			}
+		}
+		//Ordered containers are written in order, so their end is the right
+		//hint.
 		while (s.size() != (size_t)size){
 			ValueT temp;
 			this->deserialize(temp);
-			s.insert(std::move(temp));
+			s.insert(s.end(), std::move(temp));
 		}
 	}
 	template <typename SetT, typename ValueT>
@@ -164,7 +343,7 @@ private:
 		wire_size_t size;
 		this->deserialize(size);
 		while (s.size() != (size_t)size)
-			s.emplace(*this);
+			s.emplace_hint(s.end(), *this);
 	}
 	template <typename MapT, typename KeyT, typename ValueT>
 	typename std::enable_if<
@@ -175,12 +354,18 @@ private:
 		m.clear();
 		wire_size_t size;
 		this->deserialize(size);
+		if constexpr (is_ordered_container<MapT>::value && is_delta_key<KeyT>::value){
+			if (this->wire_format & wire_flags::sorted_key_deltas){
+				this->deserialize_key_deltas(m, (size_t)size);
+				return;
+			}
+		}
 		while (m.size() != (size_t)size){
 			KeyT ktemp;
 			ValueT vtemp;
 			this->deserialize(ktemp);
 			this->deserialize(vtemp);
-			m[ktemp] = vtemp;
+			m.emplace_hint(m.end(), std::move(ktemp), std::move(vtemp));
 		}
 	}
 	template <typename MapT, typename KeyT, typename ValueT>
@@ -192,10 +377,16 @@ private:
 		m.clear();
 		wire_size_t size;
 		this->deserialize(size);
+		if constexpr (is_ordered_container<MapT>::value && is_delta_key<KeyT>::value){
+			if (this->wire_format & wire_flags::sorted_key_deltas){
+				this->deserialize_key_deltas(m, (size_t)size);
+				return;
+			}
+		}
 		while (m.size() != (size_t)size){
 			KeyT ktemp;
 			this->deserialize(ktemp);
-			m.emplace(std::pair<KeyT &, decltype(*this) &>(ktemp, *this));
+			m.emplace_hint(m.end(), std::pair<KeyT &, decltype(*this) &>(ktemp, *this));
 		}
 	}
 	template <typename MapT, typename KeyT, typename ValueT>
@@ -210,7 +401,7 @@ private:
 		typedef decltype(*this) DS;
 		proxy_constructor<DS> proxy(*this);
 		while (m.size() != (size_t)size)
-			m.emplace(std::pair<DS &, decltype(proxy) &>(*this, proxy));
+			m.emplace_hint(m.end(), std::pair<DS &, decltype(proxy) &>(*this, proxy));
 	}
 	template <typename MapT, typename KeyT, typename ValueT>
 	typename std::enable_if<
@@ -223,14 +414,19 @@ private:
 		this->deserialize(size);
 		typedef decltype(*this) DS;
 		while (m.size() != (size_t)size)
-			m.emplace(std::pair<DS &, DS &>(*this, *this));
+			m.emplace_hint(m.end(), std::pair<DS &, DS &>(*this, *this));
 	}
 public:
 	DeserializerStream(std::istream &);
-	virtual ~DeserializerStream(){}
+	DeserializerStream(InputSource &);
+	//Decodes directly from memory. The buffer must outlive the stream.
+	DeserializerStream(const void *data, size_t size);
+	virtual ~DeserializerStream();
 	virtual void report_error(ErrorType);
 	template <typename Target>
 	std::unique_ptr<Target> full_deserialization(const Options &o){
+		if (this->session_metadata)
+			this->report_error(ErrorType::InvalidProgramState);
 		auto metadata = Target::static_get_metadata();
 		auto p = this->perform_deserialization(*metadata, o);
 		auto ret = dynamic_cast<Target *>(p.get());
@@ -248,6 +444,81 @@ public:
 		Options o{ includes_typehashes };
 		return this->full_deserialization<Target>(o);
 	}
+	//Allocates the whole graph from a single DeserializationArena. The
+	//returned pointer shares ownership of the arena, so the graph lives until
+	//the last std::shared_ptr into it is gone. The graph may not contain
+	//std::unique_ptrs, and std::shared_ptrs inside the graph don't own their
+	//objects; they must not outlive the arena.
+	template <typename Target>
+	std::shared_ptr<Target> full_deserialization_arena(const Options &o){
+		if (this->session_metadata)
+			this->report_error(ErrorType::InvalidProgramState);
+		auto metadata = Target::static_get_metadata();
+		auto arena = std::make_shared<DeserializationArena>(metadata);
+		this->arena = arena.get();
+		Serializable *p;
+		try{
+			p = this->perform_deserialization(*metadata, o).release();
+		}catch (...){
+			this->arena = nullptr;
+			throw;
+		}
+		this->arena = nullptr;
+		auto ret = dynamic_cast<Target *>(p);
+		if (!ret)
+			return {};
+		return std::shared_ptr<Target>(arena, ret);
+	}
+	template <typename Target>
+	std::shared_ptr<Target> full_deserialization_arena(bool includes_typehashes){
+		Options o{ includes_typehashes };
+		return this->full_deserialization_arena<Target>(o);
+	}
+	//Decodes the next message of a session (see
+	//SerializerStream::begin_session()). The messages must be decoded in the
+	//order they were sent, all by this stream. The objects of earlier messages
+	//are kept so that later ones can point to them, and the stream owns them
+	//all: they're destroyed along with it. The objects may not be owned by
+	//std::unique_ptrs, and std::shared_ptrs to them don't own them.
+	template <typename Target>
+	Target *full_deserialization_session(const Options &o){
+		auto metadata = Target::static_get_metadata();
+		if (!this->session_metadata)
+			this->session_metadata = metadata;
+		else if (this->session_metadata != metadata)
+			this->report_error(ErrorType::InvalidProgramState);
+		return dynamic_cast<Target *>(this->perform_deserialization(*metadata, o).release());
+	}
+	//Decodes many independent messages on several threads, each with its own
+	//stream. The streams only share the metadata, which is read-only, so each
+	//message may use different type hashes. A message that fails to decode
+	//gives a null pointer, and its error is stored in errors. If errors is
+	//null, the first error is rethrown once every message has been processed.
+	template <typename Target>
+	static std::vector<std::unique_ptr<Target>> full_deserialization_batch(
+			const std::vector<std::pair<const void *, size_t>> &messages,
+			const Options &o,
+			unsigned threads,
+			std::vector<std::exception_ptr> *errors = nullptr){
+		std::vector<std::unique_ptr<Target>> ret(messages.size());
+		std::vector<std::exception_ptr> temp;
+		if (!errors)
+			errors = &temp;
+		errors->assign(messages.size(), nullptr);
+		run_batch(messages.size(), threads, [&](size_t i){
+			try{
+				DeserializerStream ds(messages[i].first, messages[i].second);
+				ret[i] = ds.full_deserialization<Target>(o);
+			}catch (...){
+				(*errors)[i] = std::current_exception();
+			}
+		});
+		if (errors == &temp)
+			for (auto &e : temp)
+				if (e)
+					std::rethrow_exception(e);
+		return ret;
+	}
 	template <typename T>
 	void deserialize(T *&t){
 		this->deserialize_ptr<T *, T>(t, PointerType::RawPointer);
@@ -262,17 +533,24 @@ public:
 	}
 	template <typename T, size_t N>
 	void deserialize_array(T (&array)[N]){
+		if constexpr (std::is_floating_point_v<T>){
+			this->deserialize_floats(array, N);
+			return;
+		}
 		for (auto &e : array)
 			this->deserialize(e);
 	}
 	template <typename T, size_t N>
 	void deserialize(std::array<T, N> &array){
+		if constexpr (std::is_floating_point_v<T>){
+			this->deserialize_floats(array.data(), N);
+			return;
+		}
 		for (auto &e : array)
 			this->deserialize(e);
 	}
 	void deserialize(std::uint8_t &c){
-		this->stream->read((char *)&c, 1);
-		if (this->stream->gcount() < 1)
+		if (!this->source->get(c))
 			this->report_error(ErrorType::UnexpectedEndOfFile);
 	}
 	template <typename T>
@@ -281,12 +559,11 @@ public:
 		c = T(*this);
 	}
 	void deserialize(std::int8_t &c){
-		this->stream->read((char *)&c, 1);
-		if (this->stream->gcount() < 1)
+		if (!this->source->get((std::uint8_t &)c))
 			this->report_error(ErrorType::UnexpectedEndOfFile);
 	}
 	void deserialize(bool &b){
-		std::uint8_t temp;
+		std::uint8_t temp = 0;
 		this->deserialize(temp);
 		b = temp != 0;
 	}
@@ -294,19 +571,37 @@ public:
 	typename std::enable_if<std::is_unsigned<T>::value, void>::type deserialize_fixed(T &n){
 		static_assert(CHAR_BIT == 8, "Only 8-bit byte platforms supported!");
 
-		std::uint8_t array[sizeof(n)];
-		if (!*this->stream)
-			this->report_error(ErrorType::UnexpectedEndOfFile);
-		this->stream->read((char *)array, sizeof(array));
-		auto read = this->stream->gcount();
-		if (read != sizeof(array))
+		if (!this->source->ensure(sizeof(n)))
 			this->report_error(ErrorType::UnexpectedEndOfFile);
+		auto array = this->source->data();
+#ifndef SERIALIZATION_BIG_ENDIAN
+		memcpy(&n, array, sizeof(n));
+#else
 		unsigned shift = 0;
 		n = 0;
-		for (auto i : array){
-			n |= (T)i << shift;
+		for (size_t i = 0; i < sizeof(n); i++){
+			n |= (T)array[i] << shift;
 			shift += 8;
 		}
+#endif
+		this->source->advance(sizeof(n));
+	}
+	//Reads n values the same way deserialize() would one at a time.
+	template <typename T>
+	void deserialize_floats(T *p, size_t n){
+		static_assert(std::numeric_limits<T>::is_iec559, "Only iec559 float/doubles supported!");
+		typedef typename floating_point_mapping<T>::type U;
+		static_assert(sizeof(U) == sizeof(T), "Hard-coded integer type doesn't match the size of requested float type!");
+		if (this->source->read(p, n * sizeof(T)) != n * sizeof(T))
+			this->report_error(ErrorType::UnexpectedEndOfFile);
+#ifdef SERIALIZATION_BIG_ENDIAN
+		for (size_t i = 0; i < n; i++){
+			U u;
+			memcpy(&u, p + i, sizeof(u));
+			u = byte_swap(u);
+			memcpy(p + i, &u, sizeof(u));
+		}
+#endif
 	}
 	template <typename T>
 	typename std::enable_if<std::is_signed<T>::value && std::is_integral<T>::value, void>::type deserialize(T &z){
@@ -319,13 +614,33 @@ public:
 	typename std::enable_if<std::is_unsigned<T>::value, void>::type deserialize(T &n){
 		static_assert(CHAR_BIT == 8, "Only 8-bit byte platforms supported!");
 
+		if (this->wire_format & wire_flags::prefix_varints){
+			n = (T)this->deserialize_prefix_varint();
+			return;
+		}
+
 		const unsigned shift = 7;
+		const size_t max_length = (sizeof(n) * 8 + 6) / 7;
 
 		n = 0;
 
 		const std::uint8_t more_mask = 0x80;
 		const std::uint8_t mask = ~more_mask;
-		std::uint8_t byte;
+		std::uint8_t byte = 0;
+		if (this->source->available() >= max_length){
+			//Fast path: the whole number is buffered, so there's no need to
+			//check for EOF on every byte.
+			auto p = this->source->data();
+			size_t i = 0;
+			do{
+				byte = p[i++];
+				n <<= shift;
+				n |= byte & mask;
+			}while ((byte & more_mask) == more_mask && i < max_length);
+			this->source->advance(i);
+			if ((byte & more_mask) != more_mask)
+				return;
+		}
 		do {
 			this->deserialize(byte);
 			n <<= shift;
@@ -343,12 +658,17 @@ public:
 		wire_size_t size;
 		this->deserialize(size);
 		s.resize((size_t)size, (char)0);
-		this->stream->read(s.data(), s.size());
-		if (this->stream->gcount() != s.size())
+		if (this->source->read(s.data(), s.size()) != s.size())
 			this->report_error(ErrorType::UnexpectedEndOfFile);
 	}
 	template <typename T>
 	void deserialize(std::basic_string<T> &s){
+		if constexpr (block_codec::is_block_integer<T>::value){
+			if (this->wire_format & wire_flags::block_integers){
+				this->deserialize_block(s);
+				return;
+			}
+		}
 		wire_size_t size;
 		this->deserialize(size);
 		s.resize((size_t)size, (T)0);
@@ -359,25 +679,56 @@ public:
 		}
 	}
 	template <typename T>
+	void deserialize(buffer_view<T> &v){
+		wire_size_t size;
+		this->deserialize(size);
+		if (size > SIZE_MAX || !this->source->ensure((size_t)size))
+			this->report_error(ErrorType::UnexpectedEndOfFile);
+		auto data = this->source->data();
+		auto owner = this->source->get_owner();
+		if (owner)
+			v = buffer_view<T>((const T *)data, (size_t)size, std::move(owner));
+		else
+			v = buffer_view<T>::copy_of(data, (size_t)size);
+		this->source->advance((size_t)size);
+	}
+	template <typename T>
 	std::enable_if_t<std::is_same_v<T, std::uint8_t> || std::is_same_v<T, std::int8_t>, void>
 	deserialize(std::vector<T> &s){
 		wire_size_t size;
 		this->deserialize(size);
 		s.resize((size_t)size, (char)0);
-		this->stream->read((char *)s.data(), s.size());
-		if (this->stream->gcount() != s.size())
+		if (this->source->read(s.data(), s.size()) != s.size())
 			this->report_error(ErrorType::UnexpectedEndOfFile);
 	}
 	template <typename T>
 	std::enable_if_t<is_simply_constructible<T>::value && !(std::is_same_v<T, std::uint8_t> || std::is_same_v<T, std::int8_t>), void>
 	deserialize(std::vector<T> &v){
+		if constexpr (std::is_floating_point_v<T>){
+			v.clear();
+			wire_size_t size;
+			this->deserialize(size);
+			while (v.size() < size){
+				auto read = v.size();
+				v.resize(read + next_chunk<T>(read, size));
+				this->deserialize_floats(v.data() + read, v.size() - read);
+			}
+			return;
+		}
+		if constexpr (block_codec::is_block_integer<T>::value){
+			if (this->wire_format & wire_flags::block_integers){
+				this->deserialize_block(v);
+				return;
+			}
+		}
 		v.clear();
 		wire_size_t size;
 		this->deserialize(size);
-		v.reserve((size_t)size);
-		while (v.size() != (size_t)size){
-			v.resize(v.size() + 1);
-			this->deserialize(v.back());
+		while (v.size() < size){
+			auto read = v.size();
+			v.resize(read + next_chunk<T>(read, size));
+			for (size_t i = read; i < v.size(); i++)
+				this->deserialize(v[i]);
 		}
 	}
 	template <typename T>
@@ -386,10 +737,24 @@ public:
 		v.clear();
 		wire_size_t size;
 		this->deserialize(size);
-		v.reserve((size_t)size);
-		while (v.size() != (size_t)size)
+		v.reserve(next_chunk<T>(0, size));
+		while (v.size() < size)
 			v.emplace_back(*this);
 	}
+	//For members declared as gorilla.
+	std::vector<double> deserialize_gorilla(){
+		wire_size_t n, size;
+		this->deserialize(n);
+		this->deserialize(size);
+		//Every value takes at least one bit.
+		if (size > SIZE_MAX / 8 || n > size * 8 || !this->source->ensure((size_t)size))
+			this->report_error(ErrorType::UnexpectedEndOfFile);
+		std::vector<double> ret((size_t)n);
+		if (!gorilla::decode(this->source->data(), (size_t)size, ret.size(), ret.data()))
+			this->report_error(ErrorType::MalformedData);
+		this->source->advance((size_t)size);
+		return ret;
+	}
 	template <typename T>
 	typename std::enable_if<is_setlike<T>::value, void>::type deserialize(T &s){
 		this->deserialize_setlike<T, typename T::value_type>(s);
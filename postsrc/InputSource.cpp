@@ -0,0 +1,199 @@
+#include "InputSource.hpp"
+#include <algorithm>
+#include <system_error>
+#include <cerrno>
+#include <fstream>
+#include <vector>
+#include <iterator>
+#if !defined _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+size_t InputSource::read_slow(void *dst, size_t n){
+	auto p = (std::uint8_t *)dst;
+	size_t ret = 0;
+	while (n){
+		if (!this->available() && !this->underflow(1))
+			break;
+		auto m = std::min(n, this->available());
+		memcpy(p, this->cursor, m);
+		this->cursor += m;
+		p += m;
+		n -= m;
+		ret += m;
+	}
+	return ret;
+}
+
+//------------------------------------------------------------------------------
+
+IstreamSource::IstreamSource(std::istream &stream, size_t buffer_size): stream(&stream), buffer(new std::uint8_t[std::max<size_t>(buffer_size, 64)]), capacity(std::max<size_t>(buffer_size, 64)){
+	this->cursor = this->end = this->buffer.get();
+	//tellg() doesn't touch the state on success, but may set failbit.
+	auto state = stream.rdstate();
+	this->read_ahead = stream.tellg() != std::streampos(-1);
+	stream.clear(state);
+}
+
+void IstreamSource::grow(size_t capacity){
+	auto remaining = this->available();
+	std::unique_ptr<std::uint8_t[]> temp(new std::uint8_t[capacity]);
+	memcpy(temp.get(), this->cursor, remaining);
+	this->buffer = std::move(temp);
+	this->capacity = capacity;
+	this->cursor = this->buffer.get();
+	this->end = this->cursor + remaining;
+}
+
+bool IstreamSource::underflow(size_t n){
+	auto remaining = this->available();
+	memmove(this->buffer.get(), this->cursor, remaining);
+	auto begin = this->buffer.get();
+	this->cursor = begin;
+	this->end = begin + remaining;
+	while (remaining < n && *this->stream){
+		if (remaining == this->capacity){
+			this->grow(std::min(this->capacity * 2, n));
+			begin = this->buffer.get();
+		}
+		auto wanted = (this->read_ahead ? this->capacity : std::min(this->capacity, n)) - remaining;
+		this->stream->read((char *)begin + remaining, wanted);
+		remaining += (size_t)this->stream->gcount();
+		this->end = begin + remaining;
+	}
+	return remaining >= n;
+}
+
+size_t IstreamSource::read_slow(void *dst, size_t n){
+	auto p = (std::uint8_t *)dst;
+	auto m = this->available();
+	memcpy(p, this->cursor, m);
+	this->cursor = this->end = this->buffer.get();
+	if (this->read_ahead && n - m < this->capacity)
+		return m + InputSource::read_slow(p + m, n - m);
+	//Large blocks, and everything when not reading ahead, bypass the buffer.
+	this->stream->read((char *)p + m, n - m);
+	return m + (size_t)this->stream->gcount();
+}
+
+void IstreamSource::sync(){
+	auto remaining = this->available();
+	this->cursor = this->end = this->buffer.get();
+	if (!remaining)
+		return;
+	this->stream->clear();
+	this->stream->seekg(-(std::streamoff)remaining, std::ios::cur);
+	//Not seekable. The data is lost, but the stream remains usable.
+	if (this->stream->fail())
+		this->stream->clear();
+}
+
+//------------------------------------------------------------------------------
+
+#if !defined _WIN32
+
+static size_t get_page_size(){
+	static const size_t ret = (size_t)sysconf(_SC_PAGESIZE);
+	return ret;
+}
+
+MappedFileSource::MappedFileSource(const char *path, bool drop_behind, size_t window_size): window_size(std::max<size_t>(window_size, get_page_size())), drop_behind(drop_behind){
+	int fd;
+	do
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+	while (fd < 0 && errno == EINTR);
+	if (fd < 0)
+		throw std::system_error(errno, std::generic_category(), path);
+	struct stat st;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && (std::uint64_t)st.st_size <= SIZE_MAX){
+		auto size = (size_t)st.st_size;
+		auto p = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p != MAP_FAILED){
+			try{
+				this->owner.reset(p, [size](void *p){ munmap(p, size); });
+			}catch (...){
+				munmap(p, size);
+				close(fd);
+				throw;
+			}
+			this->mapping_size = size;
+			this->begin = (const std::uint8_t *)p;
+			this->file_end = this->begin + size;
+			madvise(p, size, MADV_SEQUENTIAL);
+		}
+	}
+	if (!this->mapping_size){
+		//Not a regular file, or empty, or couldn't be mapped. Read it in.
+		auto buffer = std::make_shared<std::vector<std::uint8_t>>();
+		this->owner = buffer;
+		while (true){
+			auto size = buffer->size();
+			buffer->resize(std::max<size_t>(size * 2, 1 << 16));
+			auto n = ::read(fd, buffer->data() + size, buffer->size() - size);
+			buffer->resize(size + std::max<ssize_t>(n, 0));
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n < 0){
+				auto error = errno;
+				close(fd);
+				throw std::system_error(error, std::generic_category(), path);
+			}
+			if (!n)
+				break;
+		}
+		this->begin = buffer->data();
+		this->file_end = this->begin + buffer->size();
+	}
+	close(fd);
+	this->cursor = this->end = this->released = this->begin;
+}
+
+bool MappedFileSource::underflow(size_t n){
+	if (!this->mapping_size){
+		this->end = this->file_end;
+		return this->available() >= n;
+	}
+	auto page_size = get_page_size();
+	auto page = [this, page_size](const std::uint8_t *p){
+		return this->begin + (p - this->begin) / page_size * page_size;
+	};
+	if (this->drop_behind){
+		auto first_needed = page(this->cursor);
+		if (first_needed > this->released){
+			madvise((void *)this->released, first_needed - this->released, MADV_DONTNEED);
+			this->released = first_needed;
+		}
+	}
+	auto remaining = (size_t)(this->file_end - this->cursor);
+	this->end = this->cursor + std::min(remaining, std::max(n, this->window_size));
+	//Start reading the next window while this one is being decoded.
+	auto ahead = std::min((size_t)(this->file_end - this->end), this->window_size);
+	if (ahead)
+		madvise((void *)page(this->end), (this->end - page(this->end)) + ahead, MADV_WILLNEED);
+	return this->available() >= n;
+}
+
+#else
+
+MappedFileSource::MappedFileSource(const char *path, bool drop_behind, size_t window_size): window_size(window_size), drop_behind(drop_behind){
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		throw std::system_error(errno, std::generic_category(), path);
+	auto buffer = std::make_shared<std::vector<std::uint8_t>>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	if (file.bad())
+		throw std::system_error(errno, std::generic_category(), path);
+	this->owner = buffer;
+	this->begin = buffer->data();
+	this->file_end = this->begin + buffer->size();
+	this->cursor = this->end = this->released = this->begin;
+}
+
+bool MappedFileSource::underflow(size_t n){
+	this->end = this->file_end;
+	return this->available() >= n;
+}
+
+#endif
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+
+//Origin of the bytes consumed by DeserializerStream. A source exposes a
+//window [cursor, end) of readable memory; the deserializer decodes directly
+//out of it and only calls into the (virtual) slow path when the window is
+//exhausted.
+class InputSource{
+protected:
+	const std::uint8_t *cursor = nullptr;
+	const std::uint8_t *end = nullptr;
+
+	//Must make at least n bytes available in [cursor, end). Returns false if
+	//the input ends before that.
+	virtual bool underflow(size_t n) = 0;
+	//Called when a read can't be satisfied from the current window. Returns
+	//the number of bytes actually read.
+	virtual size_t read_slow(void *dst, size_t n);
+public:
+	InputSource() = default;
+	InputSource(const InputSource &) = delete;
+	InputSource &operator=(const InputSource &) = delete;
+	virtual ~InputSource(){}
+	size_t available() const{
+		return this->end - this->cursor;
+	}
+	//Returns true if at least n bytes can be read.
+	bool ensure(size_t n){
+		return this->available() >= n || this->underflow(n);
+	}
+	const std::uint8_t *data() const{
+		return this->cursor;
+	}
+	void advance(size_t n){
+		this->cursor += n;
+	}
+	//c is zero when there's nothing left.
+	bool get(std::uint8_t &c){
+		if (this->cursor == this->end && !this->underflow(1)){
+			c = 0;
+			return false;
+		}
+		c = *this->cursor++;
+		return true;
+	}
+	size_t read(void *dst, size_t n){
+		if (this->available() < n)
+			return this->read_slow(dst, n);
+		if (n)
+			memcpy(dst, this->cursor, n);
+		this->cursor += n;
+		return n;
+	}
+	//Called once the deserializer is done with the input. Sources that read
+	//ahead may use it to give back the data they didn't consume.
+	virtual void sync(){}
+	//If the memory returned by data() stays valid and unchanged for as long
+	//as the returned object exists, returns that object, so that views can
+	//point into it. Otherwise returns null, and views get a copy.
+	virtual std::shared_ptr<const void> get_owner() const{
+		return nullptr;
+	}
+};
+
+//Decodes straight out of a block of memory that outlives the source.
+class MemorySource : public InputSource{
+	const std::uint8_t *begin;
+	std::shared_ptr<const void> owner;
+protected:
+	bool underflow(size_t) override{
+		return false;
+	}
+public:
+	//If owner is set, string_view and bytes_view objects point directly into
+	//the data and keep owner alive.
+	MemorySource(const void *data, size_t size, std::shared_ptr<const void> owner = nullptr): begin((const std::uint8_t *)data), owner(std::move(owner)){
+		this->cursor = this->begin;
+		this->end = this->begin + size;
+	}
+	std::shared_ptr<const void> get_owner() const override{
+		return this->owner;
+	}
+	size_t position() const{
+		return this->cursor - this->begin;
+	}
+};
+
+//Reads an std::istream in large blocks if it's seekable, in which case sync()
+//rewinds it to just after the last byte consumed. Other streams (pipes,
+//sockets) are read exactly as far as needed, so the data that follows the
+//message stays in the stream.
+//The buffer only grows as the data arrives, so a corrupt length can't make
+//it much larger than the stream itself.
+class IstreamSource : public InputSource{
+	std::istream *stream;
+	std::unique_ptr<std::uint8_t[]> buffer;
+	size_t capacity;
+	bool read_ahead;
+	void grow(size_t capacity);
+protected:
+	bool underflow(size_t n) override;
+	size_t read_slow(void *dst, size_t n) override;
+public:
+	static const size_t default_buffer_size = 1 << 16;
+	IstreamSource(std::istream &stream, size_t buffer_size = default_buffer_size);
+	void sync() override;
+};
+
+//Decodes straight out of a read-only memory mapping of a file. The mapping
+//is exposed in windows of window_size bytes, and as each window is
+//requested the OS is told to read ahead the next one and, if drop_behind is
+//set, to release the pages that have already been consumed. Files that
+//can't be mapped (and every file on systems without mmap()) are read into
+//memory instead.
+//Throws std::system_error if the file can't be opened or read.
+class MappedFileSource : public InputSource{
+	const std::uint8_t *begin = nullptr;
+	const std::uint8_t *file_end = nullptr;
+	//Start of the pages that haven't been released yet.
+	const std::uint8_t *released = nullptr;
+	size_t mapping_size = 0;
+	//Unmaps the file, or frees the buffer it was read into, once neither the
+	//source nor any view into it needs it anymore.
+	std::shared_ptr<const void> owner;
+	size_t window_size;
+	bool drop_behind;
+protected:
+	bool underflow(size_t n) override;
+public:
+	static const size_t default_window_size = 1 << 24;
+	MappedFileSource(const char *path, bool drop_behind = true, size_t window_size = default_window_size);
+	MappedFileSource(const std::string &path, bool drop_behind = true, size_t window_size = default_window_size)
+		: MappedFileSource(path.c_str(), drop_behind, window_size){}
+	//The entire file. Only stays resident if drop_behind is false.
+	const void *get_data() const{
+		return this->begin;
+	}
+	size_t size() const{
+		return this->file_end - this->begin;
+	}
+	size_t position() const{
+		return this->cursor - this->begin;
+	}
+	bool is_mapped() const{
+		return this->mapping_size != 0;
+	}
+	std::shared_ptr<const void> get_owner() const override{
+		return this->owner;
+	}
+};
@@ -0,0 +1,140 @@
+#include "LazyDeserializer.hpp"
+#include "Serializable.hpp"
+#include <algorithm>
+
+typedef DeserializerStream::ErrorType ErrorType;
+
+LazyDeserializer::LazyDeserializer(const void *data, size_t size, std::shared_ptr<const SerializableMetadata> metadata, const DeserializerStream::Options &options): metadata(std::move(metadata)), header_source(data, size), stream(header_source){
+	this->stream.metadata = this->metadata.get();
+	if (!this->stream.read_header(*this->metadata, options, this->type_map, this->root_object_id))
+		this->stream.report_error(ErrorType::AllocateObjectOfUnknownType);
+	//Object IDs must be in increasing order for get_object_type().
+	for (size_t i = 1; i < this->type_map.size(); i++)
+		if (this->type_map[i].second <= this->type_map[i - 1].second)
+			this->stream.report_error(ErrorType::UnknownObjectId);
+	this->object_count = DeserializerStream::count_objects(this->type_map);
+	if (!this->root_object_id || this->root_object_id > this->object_count)
+		this->stream.report_error(ErrorType::UnknownObjectId);
+	size_t table_size = ((size_t)this->object_count + 1) * sizeof(std::uint64_t);
+	if (!this->header_source.ensure(table_size))
+		this->stream.report_error(ErrorType::UnexpectedEndOfFile);
+	this->offset_table = this->header_source.data();
+	this->header_source.advance(table_size);
+	this->nodes = this->header_source.data();
+	this->nodes_size = this->header_source.available();
+}
+
+LazyDeserializer::~LazyDeserializer(){
+	for (auto i = this->decoded.size(); i--;){
+		auto &[type, p] = this->decoded[i];
+		this->metadata->destroy_object(type, p);
+		::operator delete(p);
+	}
+}
+
+std::uint64_t LazyDeserializer::get_offset(objectid_t oid) const{
+	auto p = this->offset_table + (oid - 1) * sizeof(std::uint64_t);
+	std::uint64_t ret = 0;
+	for (size_t i = sizeof(ret); i--;){
+		ret <<= 8;
+		ret |= p[i];
+	}
+	return ret;
+}
+
+std::uint32_t LazyDeserializer::get_object_type(objectid_t oid) const{
+	if (!oid || oid > this->object_count)
+		return 0;
+	auto it = std::lower_bound(
+		this->type_map.begin(),
+		this->type_map.end(),
+		oid,
+		[](const std::pair<std::uint32_t, objectid_t> &run, objectid_t oid){
+			return run.second < oid;
+		}
+	);
+	return it->first;
+}
+
+void LazyDeserializer::require(objectid_t oid){
+	if (!oid || oid > this->object_count)
+		this->stream.report_error(ErrorType::UnknownObjectId);
+	if (this->slots.find(oid) != this->slots.end())
+		return;
+	auto type = this->get_object_type(oid);
+	auto mem = this->metadata->allocate_memory(this->stream, type);
+	if (!mem)
+		this->stream.report_error(ErrorType::AllocateAbstractObject);
+	try{
+		auto &slot = this->slots[oid];
+		slot.address = mem;
+		slot.type = type;
+	}catch (...){
+		::operator delete(mem);
+		throw;
+	}
+	try{
+		this->batch.push_back(oid);
+	}catch (...){
+		this->slots.erase(oid);
+		::operator delete(mem);
+		throw;
+	}
+}
+
+void *LazyDeserializer::decode(objectid_t oid){
+	auto it = this->slots.find(oid);
+	if (it != this->slots.end())
+		return it->second.address;
+
+	auto &stream = this->stream;
+	this->batch.clear();
+	size_t constructed = 0;
+	stream.lazy = this;
+	try{
+		this->require(oid);
+		//Decoding an object may add more objects to the batch.
+		for (; constructed < this->batch.size(); constructed++){
+			auto id = this->batch[constructed];
+			auto begin = this->get_offset(id);
+			auto end = this->get_offset(id + 1);
+			if (begin > end || end > this->nodes_size)
+				stream.report_error(ErrorType::UnexpectedEndOfFile);
+			MemorySource source(this->nodes + begin, (size_t)(end - begin));
+			stream.source = &source;
+			auto &slot = this->slots[id];
+			this->metadata->construct_memory(slot.type, slot.address, stream);
+			stream.source = &this->header_source;
+		}
+		stream.set_backpatched_pointers();
+		stream.pointers.clear();
+		this->decoded.reserve(this->decoded.size() + this->batch.size());
+		for (auto id : this->batch)
+			this->decoded.emplace_back(this->slots[id].type, this->slots[id].address);
+	}catch (...){
+		stream.lazy = nullptr;
+		stream.source = &this->header_source;
+		stream.pointers.clear();
+		for (size_t i = 0; i < constructed; i++){
+			auto &slot = this->slots[this->batch[i]];
+			this->metadata->rollback_construction(slot.type, slot.address);
+		}
+		for (auto id : this->batch){
+			::operator delete(this->slots[id].address);
+			this->slots.erase(id);
+		}
+		this->batch.clear();
+		throw;
+	}
+	stream.lazy = nullptr;
+	this->batch.clear();
+	return this->slots[oid].address;
+}
+
+Serializable *LazyDeserializer::get_object(objectid_t oid){
+	auto p = this->decode(oid);
+	auto type = this->slots[oid].type;
+	if (!this->metadata->type_is_serializable(type))
+		return nullptr;
+	return this->metadata->perform_dynamic_cast(p, type);
+}
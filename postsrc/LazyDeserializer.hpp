@@ -0,0 +1,70 @@
+#pragma once
+
+#include "DeserializerStream.hpp"
+#include "InputSource.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+//Random access to a message serialized with
+//SerializerStream::Options::include_offset_table. Objects are only decoded
+//when they're requested. Since the decoded objects are linked by ordinary
+//pointers, requesting an object also decodes every object reachable from it.
+//
+//The LazyDeserializer owns every object it decodes, and destroys them when
+//it's destroyed. For this reason the message may not contain
+//std::unique_ptrs, and std::shared_ptrs inside the decoded objects must not
+//outlive the LazyDeserializer. The buffer must outlive it as well.
+class LazyDeserializer{
+	friend class DeserializerStream;
+public:
+	typedef std::uint32_t objectid_t;
+private:
+	std::shared_ptr<const SerializableMetadata> metadata;
+	MemorySource header_source;
+	DeserializerStream stream;
+	std::vector<std::pair<std::uint32_t, objectid_t>> type_map;
+	objectid_t object_count = 0;
+	objectid_t root_object_id = 0;
+	const std::uint8_t *offset_table = nullptr;
+	const std::uint8_t *nodes = nullptr;
+	size_t nodes_size = 0;
+	//Objects allocated while decoding the current request.
+	std::vector<objectid_t> batch;
+	//Every object decoded so far, in the order they were constructed.
+	std::vector<std::pair<std::uint32_t, void *>> decoded;
+	//Only the objects that have been allocated. Everything else is found
+	//through the offset table, so untouched objects cost no memory.
+	std::unordered_map<objectid_t, DeserializerStream::ObjectSlot> slots;
+
+	std::uint64_t get_offset(objectid_t) const;
+	void require(objectid_t);
+	void *decode(objectid_t);
+public:
+	LazyDeserializer(const void *data, size_t size, std::shared_ptr<const SerializableMetadata> metadata, const DeserializerStream::Options &options = {});
+	LazyDeserializer(const LazyDeserializer &) = delete;
+	LazyDeserializer &operator=(const LazyDeserializer &) = delete;
+	~LazyDeserializer();
+	objectid_t get_object_count() const{
+		return this->object_count;
+	}
+	objectid_t get_root_id() const{
+		return this->root_object_id;
+	}
+	//Returns the type ID of an object without decoding it.
+	std::uint32_t get_object_type(objectid_t) const;
+	size_t get_decoded_count() const{
+		return this->decoded.size();
+	}
+	//Returns nullptr if the object isn't a Serializable.
+	Serializable *get_object(objectid_t);
+	template <typename T>
+	T *get_object(objectid_t oid){
+		return dynamic_cast<T *>(this->get_object(oid));
+	}
+	template <typename T>
+	T *get_root(){
+		return this->get_object<T>(this->root_object_id);
+	}
+};
@@ -0,0 +1,269 @@
+#include "OutputSink.hpp"
+#include <algorithm>
+#include <system_error>
+#include <cerrno>
+#if defined _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#include <climits>
+#endif
+
+void OutputSink::write_slow(const void *p, size_t n){
+	this->overflow(n);
+	memcpy(this->cursor, p, n);
+	this->cursor += n;
+}
+
+template <typename T>
+static std::uint8_t *grow_container(T &dst, std::uint8_t *cursor, size_t n){
+	auto used = cursor - (std::uint8_t *)dst.data();
+	auto new_size = std::max<size_t>(std::max<size_t>(dst.size() * 2, 64), used + n);
+	dst.resize(new_size);
+	return (std::uint8_t *)dst.data() + used;
+}
+
+template <typename T>
+static void truncate_container(T &dst, std::uint8_t *cursor){
+	dst.resize(cursor - (std::uint8_t *)dst.data());
+}
+
+//------------------------------------------------------------------------------
+
+StringSink::StringSink(std::string &dst): dst(&dst){
+	this->cursor = this->end = (std::uint8_t *)dst.data() + dst.size();
+}
+
+StringSink::~StringSink(){
+	this->flush();
+}
+
+void StringSink::overflow(size_t n){
+	this->cursor = grow_container(*this->dst, this->cursor, n);
+	this->end = (std::uint8_t *)this->dst->data() + this->dst->size();
+}
+
+void StringSink::flush(){
+	truncate_container(*this->dst, this->cursor);
+	this->cursor = this->end = (std::uint8_t *)this->dst->data() + this->dst->size();
+}
+
+//------------------------------------------------------------------------------
+
+VectorSink::VectorSink(std::vector<char> &dst): dst(&dst){
+	this->cursor = this->end = (std::uint8_t *)dst.data() + dst.size();
+}
+
+VectorSink::~VectorSink(){
+	this->flush();
+}
+
+void VectorSink::overflow(size_t n){
+	this->cursor = grow_container(*this->dst, this->cursor, n);
+	this->end = (std::uint8_t *)this->dst->data() + this->dst->size();
+}
+
+void VectorSink::flush(){
+	truncate_container(*this->dst, this->cursor);
+	this->cursor = this->end = (std::uint8_t *)this->dst->data() + this->dst->size();
+}
+
+//------------------------------------------------------------------------------
+
+FixedBufferSink::FixedBufferSink(void *buffer, size_t size): begin((std::uint8_t *)buffer){
+	this->cursor = this->begin;
+	this->end = this->begin + size;
+}
+
+void FixedBufferSink::overflow(size_t){
+	throw SinkOverflowException();
+}
+
+//------------------------------------------------------------------------------
+
+CountingSink::CountingSink(){
+	this->cursor = this->scratch;
+	this->end = this->scratch + sizeof(this->scratch);
+}
+
+void CountingSink::overflow(size_t n){
+	//Nothing asks for more than a few bytes at a time, since large blocks go
+	//through write_slow().
+	if (n > sizeof(this->scratch))
+		throw SinkOverflowException();
+	this->count += this->cursor - this->scratch;
+	this->cursor = this->scratch;
+}
+
+void CountingSink::write_slow(const void *, size_t n){
+	this->count += n;
+}
+
+//------------------------------------------------------------------------------
+
+IovecSink::IovecSink(size_t reference_threshold, size_t block_size): block_size(std::max<size_t>(block_size, 64)){
+	this->reference_threshold = std::max<size_t>(reference_threshold, 1);
+}
+
+void IovecSink::close_segment(){
+	if (this->cursor == this->segment_begin)
+		return;
+	auto n = (size_t)(this->cursor - this->segment_begin);
+	//Consecutive writes to the same block are merged.
+	if (this->segments.size()){
+		auto &last = this->segments.back();
+		if ((const std::uint8_t *)last.data + last.size == this->segment_begin){
+			last.size += n;
+			this->total_size += n;
+			this->segment_begin = this->cursor;
+			return;
+		}
+	}
+	this->segments.push_back({ this->segment_begin, n });
+	this->total_size += n;
+	this->segment_begin = this->cursor;
+}
+
+void IovecSink::overflow(size_t n){
+	this->close_segment();
+	auto size = std::max(n, this->block_size);
+	this->blocks.emplace_back(new std::uint8_t[size]);
+	this->cursor = this->segment_begin = this->blocks.back().get();
+	this->end = this->cursor + size;
+}
+
+void IovecSink::write_reference(const void *p, size_t n){
+	this->close_segment();
+	this->segments.push_back({ p, n });
+	this->total_size += n;
+}
+
+void IovecSink::flush(){
+	this->close_segment();
+}
+
+void IovecSink::clear(){
+	this->segments.clear();
+	this->total_size = 0;
+	if (this->blocks.size() > 1)
+		this->blocks.resize(1);
+	if (this->blocks.empty()){
+		this->cursor = this->end = this->segment_begin = nullptr;
+		return;
+	}
+	this->cursor = this->segment_begin = this->blocks.front().get();
+	this->end = this->cursor + this->block_size;
+}
+
+void IovecSink::write_to(int fd) const{
+	size_t i = 0;
+	//Bytes of segments[i] already written.
+	size_t offset = 0;
+	while (i < this->segments.size()){
+#if defined _WIN32
+		auto &segment = this->segments[i];
+		auto chunk = std::min<size_t>(segment.size - offset, 1 << 30);
+		auto written = _write(fd, (const char *)segment.data + offset, (unsigned)chunk);
+#else
+#if defined IOV_MAX
+		const size_t max_iovecs = IOV_MAX < 64 ? IOV_MAX : 64;
+#else
+		const size_t max_iovecs = 16;
+#endif
+		iovec iovecs[64];
+		size_t count = 0;
+		for (auto j = i; j < this->segments.size() && count < max_iovecs; j++, count++){
+			auto skip = j == i ? offset : 0;
+			iovecs[count].iov_base = (std::uint8_t *)this->segments[j].data + skip;
+			iovecs[count].iov_len = this->segments[j].size - skip;
+		}
+		auto written = ::writev(fd, iovecs, (int)count);
+#endif
+		if (written < 0){
+			if (errno == EINTR)
+				continue;
+			throw std::system_error(errno, std::generic_category());
+		}
+		auto n = (size_t)written;
+		while (i < this->segments.size() && n >= this->segments[i].size - offset){
+			n -= this->segments[i].size - offset;
+			offset = 0;
+			i++;
+		}
+		offset += n;
+	}
+}
+
+//------------------------------------------------------------------------------
+
+FlushingSink::FlushingSink(size_t buffer_size): buffer(new std::uint8_t[std::max<size_t>(buffer_size, 64)]), capacity(std::max<size_t>(buffer_size, 64)){
+	this->cursor = this->buffer.get();
+	this->end = this->cursor + this->capacity;
+}
+
+void FlushingSink::overflow(size_t n){
+	this->flush();
+	if (n > this->capacity){
+		this->buffer.reset(new std::uint8_t[n]);
+		this->capacity = n;
+		this->cursor = this->buffer.get();
+		this->end = this->cursor + this->capacity;
+	}
+}
+
+void FlushingSink::write_slow(const void *p, size_t n){
+	this->flush();
+	if (n >= this->capacity){
+		//Large blocks bypass the buffer.
+		this->write_out(p, n);
+		return;
+	}
+	memcpy(this->cursor, p, n);
+	this->cursor += n;
+}
+
+void FlushingSink::flush(){
+	auto begin = this->buffer.get();
+	if (this->cursor != begin)
+		this->write_out(begin, this->cursor - begin);
+	this->cursor = begin;
+}
+
+//------------------------------------------------------------------------------
+
+OstreamSink::~OstreamSink(){
+	try{
+		this->flush();
+	}catch (...){}
+}
+
+void OstreamSink::write_out(const void *p, size_t n){
+	this->stream->write((const char *)p, n);
+}
+
+//------------------------------------------------------------------------------
+
+FdSink::~FdSink(){
+	try{
+		this->flush();
+	}catch (...){}
+}
+
+void FdSink::write_out(const void *p, size_t n){
+	auto data = (const char *)p;
+	while (n){
+#if defined _WIN32
+		auto written = _write(this->fd, data, (unsigned)std::min<size_t>(n, 1 << 30));
+#else
+		auto written = ::write(this->fd, data, n);
+#endif
+		if (written < 0){
+			if (errno == EINTR)
+				continue;
+			throw std::system_error(errno, std::generic_category());
+		}
+		data += written;
+		n -= (size_t)written;
+	}
+}
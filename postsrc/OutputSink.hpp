@@ -0,0 +1,218 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <memory>
+#include "noexcept.hpp"
+
+class SinkOverflowException : public std::exception{
+public:
+	const char *what() const NOEXCEPT override{
+		return "The output buffer is too small to hold the serialized data.";
+	}
+};
+
+//Destination of the bytes produced by SerializerStream. A sink exposes a
+//window [cursor, end) of writable memory; the serializer stores directly into
+//it and only calls into the (virtual) slow path when the window is exhausted.
+class OutputSink{
+protected:
+	std::uint8_t *cursor = nullptr;
+	std::uint8_t *end = nullptr;
+	//Blocks at least this large are passed to write_reference().
+	size_t reference_threshold = SIZE_MAX;
+
+	//Must make at least n bytes available in [cursor, end), or throw.
+	virtual void overflow(size_t n) = 0;
+	//Called when a write doesn't fit in the current window. The default
+	//implementation just makes room for it.
+	virtual void write_slow(const void *p, size_t n);
+	//Called by write_in_place() for large blocks. The default implementation
+	//copies them.
+	virtual void write_reference(const void *p, size_t n){
+		this->write(p, n);
+	}
+public:
+	OutputSink() = default;
+	OutputSink(const OutputSink &) = delete;
+	OutputSink &operator=(const OutputSink &) = delete;
+	virtual ~OutputSink(){}
+	void put(std::uint8_t c){
+		if (this->cursor == this->end)
+			this->overflow(1);
+		*this->cursor++ = c;
+	}
+	void write(const void *p, size_t n){
+		if ((size_t)(this->end - this->cursor) < n){
+			this->write_slow(p, n);
+			return;
+		}
+		if (n)
+			memcpy(this->cursor, p, n);
+		this->cursor += n;
+	}
+	//Same as write(), but the sink may keep a pointer to the data instead of
+	//copying it, so the data must stay alive and unchanged until the sink
+	//has been flushed and its output consumed.
+	void write_in_place(const void *p, size_t n){
+		if (n < this->reference_threshold){
+			this->write(p, n);
+			return;
+		}
+		this->write_reference(p, n);
+	}
+	size_t available() const{
+		return this->end - this->cursor;
+	}
+	//Returns a pointer to at least n writable bytes if they're available
+	//without calling overflow(), otherwise nullptr. Use commit() afterwards.
+	std::uint8_t *try_reserve(size_t n){
+		if (this->available() < n)
+			return nullptr;
+		return this->cursor;
+	}
+	void commit(std::uint8_t *new_cursor){
+		this->cursor = new_cursor;
+	}
+	//Pushes buffered data to the final destination, if there's one.
+	virtual void flush(){}
+};
+
+//Appends to an std::string. The string itself is used as the buffer, so it
+//may temporarily be larger than the serialized data; its final size is set
+//by flush() (which SerializerStream calls when it's done) or the destructor.
+class StringSink : public OutputSink{
+	std::string *dst;
+protected:
+	void overflow(size_t n) override;
+public:
+	StringSink(std::string &dst);
+	~StringSink();
+	void flush() override;
+	//Number of bytes in the string, including unflushed data.
+	size_t size() const{
+		return this->cursor - (const std::uint8_t *)this->dst->data();
+	}
+};
+
+//Same as StringSink, but for std::vector<char>.
+class VectorSink : public OutputSink{
+	std::vector<char> *dst;
+protected:
+	void overflow(size_t n) override;
+public:
+	VectorSink(std::vector<char> &dst);
+	~VectorSink();
+	void flush() override;
+};
+
+//Writes into a caller-provided buffer. Throws SinkOverflowException if the
+//buffer is exhausted.
+class FixedBufferSink : public OutputSink{
+	std::uint8_t *begin;
+protected:
+	void overflow(size_t n) override;
+public:
+	FixedBufferSink(void *buffer, size_t size);
+	size_t size() const{
+		return this->cursor - this->begin;
+	}
+};
+
+//Discards the data and only counts the bytes. Used to measure messages
+//without keeping them in memory.
+class CountingSink : public OutputSink{
+	std::uint8_t scratch[256];
+	std::uint64_t count = 0;
+protected:
+	void overflow(size_t n) override;
+	void write_slow(const void *p, size_t n) override;
+public:
+	CountingSink();
+	std::uint64_t size() const{
+		return this->count + (this->cursor - this->scratch);
+	}
+};
+
+//Produces the output as a list of segments, suitable for writev() or
+//sendmsg(), instead of as one contiguous buffer. Encoded data is stored in
+//internal blocks, while strings and byte vectors of at least
+//reference_threshold bytes are referenced in place (see
+//OutputSink::write_in_place()).
+class IovecSink : public OutputSink{
+public:
+	struct Segment{
+		const void *data;
+		size_t size;
+	};
+private:
+	std::vector<std::unique_ptr<std::uint8_t[]>> blocks;
+	size_t block_size;
+	//Start of the data in the current block that isn't in segments yet.
+	std::uint8_t *segment_begin = nullptr;
+	std::vector<Segment> segments;
+	size_t total_size = 0;
+
+	void close_segment();
+protected:
+	void overflow(size_t n) override;
+	void write_reference(const void *p, size_t n) override;
+public:
+	static const size_t default_block_size = 1 << 16;
+	static const size_t default_reference_threshold = 1 << 12;
+	IovecSink(size_t reference_threshold = default_reference_threshold, size_t block_size = default_block_size);
+	void flush() override;
+	//Only complete after flush(), which SerializerStream calls when it's
+	//done.
+	const std::vector<Segment> &get_segments() const{
+		return this->segments;
+	}
+	//Total size of the segments.
+	size_t size() const{
+		return this->total_size;
+	}
+	//Discards the output, keeping the first block for reuse.
+	void clear();
+	//Writes every segment to a file descriptor (or a socket, on Unix) with
+	//as few system calls as possible. Throws std::system_error if a write
+	//fails.
+	void write_to(int fd) const;
+};
+
+//Base for sinks that buffer data in memory and periodically hand it over to
+//something else.
+class FlushingSink : public OutputSink{
+	std::unique_ptr<std::uint8_t[]> buffer;
+	size_t capacity;
+protected:
+	virtual void write_out(const void *p, size_t n) = 0;
+	void overflow(size_t n) override;
+	void write_slow(const void *p, size_t n) override;
+public:
+	static const size_t default_buffer_size = 1 << 16;
+	FlushingSink(size_t buffer_size = default_buffer_size);
+	void flush() override;
+};
+
+class OstreamSink : public FlushingSink{
+	std::ostream *stream;
+protected:
+	void write_out(const void *p, size_t n) override;
+public:
+	OstreamSink(std::ostream &stream, size_t buffer_size = default_buffer_size): FlushingSink(buffer_size), stream(&stream){}
+	~OstreamSink();
+};
+
+//Writes to a file descriptor (or a socket, on Unix). Throws
+//std::system_error if a write fails.
+class FdSink : public FlushingSink{
+	int fd;
+protected:
+	void write_out(const void *p, size_t n) override;
+public:
+	FdSink(int fd, size_t buffer_size = default_buffer_size): FlushingSink(buffer_size), fd(fd){}
+	~FdSink();
+};
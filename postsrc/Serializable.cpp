@@ -1,74 +1,75 @@
 #include "Serializable.hpp"
 #include "DeserializerStream.hpp"
+#include <algorithm>
 
 std::atomic<Serializable::oid_t> Serializable::next_id;
 
-void *SerializableMetadata::allocate_memory(DeserializerStream &ds, std::uint32_t type){
-	type = this->map_type(type);
+void *SerializableMetadata::allocate_memory(DeserializerStream &ds, std::uint32_t type) const{
 	if (!type)
 		ds.report_error(DeserializerStream::ErrorType::AllocateObjectOfUnknownType);
 	return this->allocator(type);
 }
 
-std::uint32_t SerializableMetadata::map_type(std::uint32_t input){
-	if (!this->typemap)
-		return input;
-	auto it = this->typemap->find(input);
-	if (it == this->typemap->end())
-		return 0;
-	return it->second;
+void SerializableMetadata::get_object_layout(DeserializerStream &ds, std::uint32_t type, size_t &size, size_t &alignment) const{
+	if (!type)
+		ds.report_error(DeserializerStream::ErrorType::AllocateObjectOfUnknownType);
+	this->object_layout(type, size, alignment);
+	if (!size)
+		ds.report_error(DeserializerStream::ErrorType::AllocateAbstractObject);
 }
 
-void SerializableMetadata::construct_memory(std::uint32_t type, void *s, DeserializerStream &ds){
+void SerializableMetadata::destroy_object(std::uint32_t type, void *p) const{
+	this->destructor(type, p);
+}
+
+void SerializableMetadata::construct_memory(std::uint32_t type, void *s, DeserializerStream &ds) const{
 	this->constructor(type, s, ds);
 }
 
-std::uint32_t SerializableMetadata::known_type_from_hash(const TypeHash &hash){
-	for (auto &p : this->known_types)
-		if (p.second == hash)
-			return p.first;
-	return 0;
+std::uint32_t SerializableMetadata::known_type_from_hash(const TypeHash &hash) const{
+	auto it = this->types_by_hash.find(hash);
+	if (it == this->types_by_hash.end())
+		return 0;
+	return it->second;
 }
 
-void SerializableMetadata::add_type(std::uint32_t type, const TypeHash &type_hash){
-	this->known_types.push_back(std::make_pair(type, type_hash));
+const TypeHash *SerializableMetadata::find_type_hash(std::uint32_t type) const{
+	auto it = std::lower_bound(
+		this->known_types.begin(),
+		this->known_types.end(),
+		type,
+		[](const std::pair<std::uint32_t, TypeHash> &p, std::uint32_t type){
+			return p.first < type;
+		}
+	);
+	if (it == this->known_types.end() || it->first != type)
+		return nullptr;
+	return &it->second;
 }
 
-void SerializableMetadata::set_type_mappings(const std::vector<std::pair<std::uint32_t, TypeHash> > &typehashes){
-	this->typemap.reset(new decltype(this->typemap)::element_type);
-	for (auto &p : typehashes){
-		auto known_type = this->known_type_from_hash(p.second);
-		if (!known_type)
-			continue;
-		(*this->typemap)[p.first] = known_type;
-	}
+void SerializableMetadata::add_type(std::uint32_t type, const TypeHash &type_hash){
+	this->known_types.push_back(std::make_pair(type, type_hash));
+	this->types_by_hash.emplace(type_hash, type);
 }
 
-void SerializableMetadata::rollback_construction(std::uint32_t type, void *p){
+void SerializableMetadata::rollback_construction(std::uint32_t type, void *p) const{
 	this->rollbacker(type, p);
 }
 
-bool SerializableMetadata::type_is_serializable(std::uint32_t type){
+bool SerializableMetadata::type_is_serializable(std::uint32_t type) const{
 	return this->is_serializable(type);
 }
 
-//std::vector<std::tuple<std::uint32_t, std::uint32_t, int>> SerializableMetadata::get_cast_offsets(){
-//	return this->cast_offsets();
-//}
-
-Serializable *SerializableMetadata::perform_dynamic_cast(void *p, std::uint32_t type){
+Serializable *SerializableMetadata::perform_dynamic_cast(void *p, std::uint32_t type) const{
 	return this->dynamic_cast_p(p, type);
 }
 
-std::unique_ptr<GenericPointer> SerializableMetadata::allocate_pointer(std::uint32_t type, PointerType pointer_type, void *pointer){
-	return this->pointer_allocator(type, pointer_type, pointer);
-}
-
-CastCategory SerializableMetadata::categorize_cast(std::uint32_t object_type, std::uint32_t dst_type){
-	return this->categorizer(object_type, dst_type);
+CastCategory SerializableMetadata::categorize_cast(std::uint32_t object_type, std::uint32_t dst_type, std::ptrdiff_t &offset) const{
+	offset = 0;
+	return this->categorizer(object_type, dst_type, offset);
 }
 
-bool SerializableMetadata::check_enum_value(std::uint32_t type, const void *value){
+bool SerializableMetadata::check_enum_value(std::uint32_t type, const void *value) const{
 	return this->enum_checker(type, value);
 }
 
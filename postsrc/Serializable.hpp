@@ -7,6 +7,7 @@
 #include <array>
 #include <atomic>
 #include <cstdint>
+#include <cstddef>
 
 static const std::uint32_t Serializable_type_id = std::numeric_limits<std::uint32_t>::max();
 
@@ -31,6 +32,14 @@ struct TypeHash{
 	bool operator<(const TypeHash &b) const{
 		return memcmp(this->digest, b.digest, 32) < 0;
 	}
+	//The digest is already uniformly distributed.
+	struct Hasher{
+		size_t operator()(const TypeHash &hash) const{
+			size_t ret;
+			memcpy(&ret, hash.digest, sizeof(ret));
+			return ret;
+		}
+	};
 };
 
 class SerializableMetadata;
@@ -58,9 +67,11 @@ public:
 		);
 	}
 	virtual void serialize(SerializerStream &) const = 0;
+	//Number of bytes serialize() would write.
+	virtual std::uint64_t serialized_size(const SerializerStream &) const = 0;
 	virtual std::uint32_t get_type_id() const = 0;
 	virtual TypeHash get_type_hash() const = 0;
-	virtual std::shared_ptr<SerializableMetadata> get_metadata() const = 0;
+	virtual std::shared_ptr<const SerializableMetadata> get_metadata() const = 0;
 	virtual void rollback_deserialization(){}
 	oid_t get_id() const{
 		return this->id;
@@ -72,81 +83,109 @@ inline ObjectNode get_object_node(const Serializable *serializable){
 	return !serializable ? ObjectNode() : serializable->get_object_node();
 }
 
-class DeserializerStream;
-
-class GenericPointer{
-public:
-	void *pointer;
-	virtual ~GenericPointer(){}
-	virtual void release() = 0;
-	virtual std::unique_ptr<GenericPointer> cast(std::uint32_t type) = 0;
-};
-
+//Trivial casts add a constant offset to the object's address. Complex casts
+//go through a virtual base, so they need the object's RTTI.
 enum class CastCategory : char{
 	Trivial = 0,
 	Complex = 1,
 	Invalid = 2,
 };
 
+//Value of a learned_base_offset that hasn't been measured yet.
+static const std::ptrdiff_t unknown_base_offset = std::numeric_limits<std::ptrdiff_t>::min();
+
+//Position of a non-virtual Base subobject in a Derived. Casting a pointer to
+//storage that doesn't hold a Derived yet is undefined behavior, and generated
+//classes can't be built just to measure them (they may be abstract, and their
+//constructors may have side effects), so the generated deserializing
+//constructor of Derived records it the first time it runs. Until then, casts
+//to Base are backpatched with RTTI; afterwards they're a constant add.
+template <typename Derived, typename Base>
+struct learned_base_offset{
+	static inline std::atomic<std::ptrdiff_t> value{ unknown_base_offset };
+
+	static void learn(const Derived *object){
+		if (value.load(std::memory_order_relaxed) != unknown_base_offset)
+			return;
+		auto offset = (const char *)static_cast<const Base *>(object) - (const char *)object;
+		value.store(offset, std::memory_order_relaxed);
+	}
+};
+
+//Describes the types of a generated file. It's built once, by the generated
+//get_metadata function, and shared by every stream, which never modify it.
+//Anything that depends on a particular message, such as the type IDs used by
+//the sender, is kept by the stream.
 class SerializableMetadata{
 public:
 	typedef void *(*allocator_t)(std::uint32_t);
 	typedef void (*constructor_t)(std::uint32_t, void *, DeserializerStream &);
 	typedef void (*rollbacker_t)(std::uint32_t, void *);
 	typedef bool (*is_serializable_t)(std::uint32_t);
-	//typedef std::vector<std::tuple<std::uint32_t, std::uint32_t, int>> (*cast_offsets_t)();
 	typedef Serializable *(*dynamic_cast_f)(void *, std::uint32_t);
-	typedef std::unique_ptr<GenericPointer> (*allocate_pointer_t)(std::uint32_t, PointerType, void *);
-	typedef CastCategory (*categorize_cast_t)(std::uint32_t, std::uint32_t);
+	typedef CastCategory (*categorize_cast_t)(std::uint32_t, std::uint32_t, std::ptrdiff_t &);
 	typedef bool (*check_enum_value_t)(std::uint32_t, const void *);
+	typedef void (*object_layout_t)(std::uint32_t, size_t &, size_t &);
+	typedef void (*destructor_t)(std::uint32_t, void *);
 private:
+	//Sorted by type ID.
 	std::vector<std::pair<std::uint32_t, TypeHash>> known_types;
-	//Used for deserialization.
-	std::unique_ptr<std::map<std::uint32_t, std::uint32_t>> typemap;
+	//If two types have the same hash, the first one.
+	std::unordered_map<TypeHash, std::uint32_t, TypeHash::Hasher> types_by_hash;
 	allocator_t allocator;
 	constructor_t constructor;
 	rollbacker_t rollbacker;
 	is_serializable_t is_serializable;
-	allocate_pointer_t pointer_allocator;
 	dynamic_cast_f dynamic_cast_p;
 	categorize_cast_t categorizer;
 	check_enum_value_t enum_checker;
-
-	std::uint32_t map_type(std::uint32_t);
-	std::uint32_t known_type_from_hash(const TypeHash &);
+	object_layout_t object_layout;
+	destructor_t destructor;
 public:
 	void add_type(std::uint32_t, const TypeHash &);
-	void set_type_mappings(const std::vector<std::pair<std::uint32_t, TypeHash> > &);
 	const std::vector<std::pair<std::uint32_t, TypeHash> > &get_known_types() const{
 		return this->known_types;
 	}
+	//Returns 0 if the hash doesn't belong to any known type.
+	std::uint32_t known_type_from_hash(const TypeHash &) const;
+	//Returns nullptr if the type isn't known.
+	const TypeHash *find_type_hash(std::uint32_t) const;
 	void set_functions(
 			allocator_t allocator,
 			constructor_t constructor,
 			rollbacker_t rollbacker,
 			is_serializable_t is_serializable,
 			dynamic_cast_f dynamic_cast_p,
-			allocate_pointer_t pointer_allocator,
 			categorize_cast_t categorizer,
-			check_enum_value_t enum_checker){
+			check_enum_value_t enum_checker,
+			object_layout_t object_layout,
+			destructor_t destructor){
 		this->allocator = allocator;
 		this->constructor = constructor;
 		this->rollbacker = rollbacker;
 		this->is_serializable = is_serializable;
 		this->dynamic_cast_p = dynamic_cast_p;
-		this->pointer_allocator = pointer_allocator;
 		this->categorizer = categorizer;
 		this->enum_checker = enum_checker;
+		this->object_layout = object_layout;
+		this->destructor = destructor;
+	}
+	void *allocate_memory(DeserializerStream &ds, std::uint32_t) const;
+	//Gets the size and alignment of an object of the given type, for callers
+	//that manage the memory themselves.
+	void get_object_layout(DeserializerStream &ds, std::uint32_t, size_t &size, size_t &alignment) const;
+	void destroy_object(std::uint32_t, void *) const;
+	destructor_t get_destructor() const{
+		return this->destructor;
 	}
-	void *allocate_memory(DeserializerStream &ds, std::uint32_t);
-	void construct_memory(std::uint32_t, void *, DeserializerStream &);
-	void rollback_construction(std::uint32_t, void *);
-	bool type_is_serializable(std::uint32_t);
-	//std::vector<std::tuple<std::uint32_t, std::uint32_t, int>> get_cast_offsets();
-	Serializable *perform_dynamic_cast(void *p, std::uint32_t type);
-	std::unique_ptr<GenericPointer> allocate_pointer(std::uint32_t type, PointerType pointer_type, void *pointer);
-	CastCategory categorize_cast(std::uint32_t object_type, std::uint32_t dst_type);
-	bool check_enum_value(std::uint32_t type, const void *);
+	void construct_memory(std::uint32_t, void *, DeserializerStream &) const;
+	void rollback_construction(std::uint32_t, void *) const;
+	bool type_is_serializable(std::uint32_t) const;
+	Serializable *perform_dynamic_cast(void *p, std::uint32_t type) const;
+	//For trivial casts, also gets what needs to be added to the address of the
+	//object to get the address of the dst_type subobject.
+	CastCategory categorize_cast(std::uint32_t object_type, std::uint32_t dst_type, std::ptrdiff_t &offset) const;
+	bool check_enum_value(std::uint32_t type, const void *) const;
 };
 
 #endif
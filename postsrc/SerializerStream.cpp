@@ -2,10 +2,94 @@
 #include "Serializable.hpp"
 #include <algorithm>
 #include <cassert>
+#include <thread>
+#include <exception>
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <climits>
+
+void IdentityMap::rehash(size_t capacity){
+	std::vector<Entry> old(capacity, Entry{ 0, 0, 0 });
+	old.swap(this->table);
+	this->mask = capacity - 1;
+	for (auto &e : old)
+		if (e.value)
+			this->table[this->find_slot(std::make_pair(!!e.is_serializable, e.key))] = e;
+}
+
+void IdentityMap::clear(){
+	std::fill(this->table.begin(), this->table.end(), Entry{ 0, 0, 0 });
+	this->count = 0;
+}
+
+void IdentityMap::reserve(size_t n){
+	size_t capacity = this->table.size();
+	while (capacity < n * 2)
+		capacity *= 2;
+	if (capacity != this->table.size())
+		this->rehash(capacity);
+}
+
+bool IdentityMap::insert(const identity_t &id, objectid_t value){
+	assert(value);
+	auto &slot = this->table[this->find_slot(id)];
+	if (slot.value)
+		return false;
+	slot = { id.second, value, id.first };
+	//Keep the load factor under 1/2.
+	if (++this->count * 2 > this->table.size())
+		this->rehash(this->table.size() * 2);
+	return true;
+}
+
+void IdentityMap::erase(const identity_t &id){
+	auto i = this->find_slot(id);
+	if (!this->table[i].value)
+		return;
+	//Backward shift: move up any entry after the hole that would no longer be
+	//reachable from its home slot.
+	for (auto j = (i + 1) & this->mask; this->table[j].value; j = (j + 1) & this->mask){
+		auto &e = this->table[j];
+		auto home = hash(std::make_pair(!!e.is_serializable, e.key)) & this->mask;
+		if (((j - home) & this->mask) < ((j - i) & this->mask))
+			continue;
+		this->table[i] = e;
+		i = j;
+	}
+	this->table[i] = Entry{ 0, 0, 0 };
+	this->count--;
+}
+
+//------------------------------------------------------------------------------
 
 SerializerStream::SerializerStream(std::ostream &stream):
 	next_object_id(1),
-	stream(&stream){
+	owned_sink(new OstreamSink(stream)),
+	sink(owned_sink.get()){
+}
+
+SerializerStream::SerializerStream(OutputSink &sink):
+	next_object_id(1),
+	sink(&sink){
+}
+
+SerializerStream::~SerializerStream(){
+	if (this->owned_sink)
+		this->owned_sink->flush();
+}
+
+void SerializerStream::begin_session(){
+	this->session = true;
+	this->session_base = 0;
+	this->next_object_id = 1;
+	this->id_map.clear();
+}
+
+void SerializerStream::rollback_session_message(){
+	for (size_t i = 1; i < this->node_map.size(); i++)
+		this->id_map.erase(this->node_map[i].get_identity());
+	this->next_object_id = this->session_base + 1;
 }
 
 SerializerStream::objectid_t SerializerStream::get_new_oid(){
@@ -13,12 +97,12 @@ SerializerStream::objectid_t SerializerStream::get_new_oid(){
 }
 
 SerializerStream::objectid_t SerializerStream::save_object(const std::pair<bool, uintptr_t> &p){
-	auto it = this->id_map.find(p);
-	if (it != this->id_map.end())
+	//The identity of the null pointer.
+	if (!p.first && !p.second)
+		return null_oid;
+	if (!this->id_map.insert(p, this->next_object_id))
 		return null_oid;
-	auto ret = this->get_new_oid();
-	this->id_map[p] = ret;
-	return ret;
+	return this->get_new_oid();
 }
 
 void SerializerStream::serialize_id_private(const void *p){
@@ -26,10 +110,10 @@ void SerializerStream::serialize_id_private(const void *p){
 		this->serialize(0);
 		return;
 	}
-	auto it = this->id_map.find(std::make_pair(false, (uintptr_t)p));
-	if (it == this->id_map.end())
+	auto id = this->get_id_map().find(std::make_pair(false, (uintptr_t)p));
+	if (!id)
 		abort();
-	this->serialize(it->second);
+	this->serialize(id);
 }
 
 void SerializerStream::serialize_id(const Serializable *p){
@@ -37,32 +121,271 @@ void SerializerStream::serialize_id(const Serializable *p){
 		this->serialize(0);
 		return;
 	}
-	auto it = this->id_map.find(std::make_pair(true, (uintptr_t)p->get_id()));
-	if (it == this->id_map.end())
+	auto id = this->get_id_map().find(std::make_pair(true, (uintptr_t)p->get_id()));
+	if (!id)
 		abort();
-	this->serialize(it->second);
+	this->serialize(id);
 }
 
 #if defined _DEBUG || defined TESTING_BUILD
 #define LOG
 #endif
 
-bool SerializerStream::full_serialization(const Serializable &obj, const Options &options){
+//Visited set shared by the traversal threads. Each identity is assigned a
+//unique, non-zero value the first time it's seen.
+class ConcurrentIdentityMap{
+	static const unsigned shard_bits = 6;
+	struct Shard{
+		std::mutex mutex;
+		IdentityMap map;
+	};
+	std::unique_ptr<Shard[]> shards;
+	std::atomic<std::uint32_t> next_value;
+public:
+	ConcurrentIdentityMap(): shards(new Shard[1 << shard_bits]), next_value(1){}
+	//Returns the identity's value, and whether it was just added.
+	std::pair<std::uint32_t, bool> insert(const IdentityMap::identity_t &id){
+		//The tables inside the shards use the low bits of the hash.
+		auto &shard = this->shards[IdentityMap::hash(id) >> (sizeof(size_t) * CHAR_BIT - shard_bits)];
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		auto value = shard.map.find(id);
+		if (value)
+			return std::make_pair(value, false);
+		value = this->next_value++;
+		shard.map.insert(id, value);
+		return std::make_pair(value, true);
+	}
+	std::uint32_t size() const{
+		return this->next_value - 1;
+	}
+};
+
+void SerializerStream::traverse_parallel(const ObjectNode &root, unsigned threads){
+	struct VisitedNode{
+		ObjectNode node;
+		size_t first_edge;
+		std::uint32_t edge_count;
+		std::uint32_t worker;
+	};
+	struct Worker{
+		std::mutex mutex;
+		//Nodes waiting to be visited, with their values. The owner works at
+		//the back, thieves steal from the front.
+		std::deque<std::pair<ObjectNode, std::uint32_t>> queue;
+		std::vector<std::pair<std::uint32_t, VisitedNode>> visited;
+		//Values of the children of each visited node, in order.
+		std::vector<std::uint32_t> edges;
+		std::exception_ptr error;
+	};
+
+	ConcurrentIdentityMap visited_set;
+	std::vector<Worker> workers(threads);
+	std::atomic<size_t> pending(1);
+	std::atomic<bool> failed(false);
+	{
+		auto value = visited_set.insert(root.get_identity()).first;
+		workers[0].queue.emplace_back(root, value);
+	}
+
+	auto work = [&](unsigned i){
+		auto &self = workers[i];
+		std::vector<ObjectNode> children;
+		try{
+			while (!failed){
+				std::pair<ObjectNode, std::uint32_t> item;
+				bool found = false;
+				{
+					std::lock_guard<std::mutex> lock(self.mutex);
+					if (self.queue.size()){
+						item = self.queue.back();
+						self.queue.pop_back();
+						found = true;
+					}
+				}
+				for (unsigned j = 1; !found && j < threads; j++){
+					auto &victim = workers[(i + j) % threads];
+					std::lock_guard<std::mutex> lock(victim.mutex);
+					if (victim.queue.size()){
+						item = victim.queue.front();
+						victim.queue.pop_front();
+						found = true;
+					}
+				}
+				if (!found){
+					if (!pending)
+						break;
+					std::this_thread::yield();
+					continue;
+				}
+
+				auto &node = item.first;
+				VisitedNode visited{ node, self.edges.size(), 0, i };
+				children.clear();
+				if (node.get_address())
+					node.get_children(children);
+				for (auto &child : children){
+					auto id = child.get_identity();
+					if (!id.first && !id.second)
+						continue;
+					//Sent in an earlier message of the session. id_map isn't
+					//modified until the replay below.
+					if (this->id_map.find(id))
+						continue;
+					auto [value, added] = visited_set.insert(id);
+					self.edges.push_back(value);
+					visited.edge_count++;
+					if (!added)
+						continue;
+					pending++;
+					std::lock_guard<std::mutex> lock(self.mutex);
+					self.queue.emplace_back(child, value);
+				}
+				self.visited.emplace_back(item.second, visited);
+				pending--;
+			}
+		}catch (...){
+			self.error = std::current_exception();
+			failed = true;
+		}
+	};
+
+	{
+		std::vector<std::thread> pool;
+		try{
+			pool.reserve(threads - 1);
+			for (unsigned i = 1; i < threads; i++)
+				pool.emplace_back(work, i);
+		}catch (...){
+			//Couldn't start all the threads. The ones that did start (and this
+			//one) can still do all the work.
+		}
+		work(0);
+		for (auto &t : pool)
+			t.join();
+	}
+	for (auto &w : workers)
+		if (w.error)
+			std::rethrow_exception(w.error);
+
+	//Replay the sequential depth-first search over the recorded edges, so
+	//that objects get the same IDs they'd get from a single thread.
+	auto count = visited_set.size();
+	std::vector<const VisitedNode *> nodes(count + 1);
+	for (auto &w : workers)
+		for (auto &[value, visited] : w.visited)
+			nodes[value] = &visited;
+	this->id_map.reserve(this->id_map.size() + count);
+	this->node_map.reserve((size_t)count + 1);
+	std::vector<bool> seen(count + 1);
+	std::vector<std::uint32_t> stack;
+
+	seen[1] = true;
+	this->save_object(root.get_identity());
+	this->node_map.push_back(root);
+	stack.push_back(1);
+	while (stack.size()){
+		auto &top = *nodes[stack.back()];
+		stack.pop_back();
+		auto edges = workers[top.worker].edges.data() + top.first_edge;
+		for (std::uint32_t i = 0; i < top.edge_count; i++){
+			auto value = edges[i];
+			if (seen[value])
+				continue;
+			seen[value] = true;
+			auto &child = nodes[value]->node;
+			this->save_object(child.get_identity());
+			this->node_map.push_back(child);
+			stack.push_back(value);
+		}
+	}
+}
+
+void SerializerStream::serialize_nodes_to_buffers(objectid_t object_count, unsigned threads, std::vector<std::string> &buffers, std::vector<std::uint64_t> *offsets){
+	threads = std::max<unsigned>(std::min<unsigned>(threads, object_count), 1);
+	buffers.resize(threads);
+	std::vector<std::vector<std::uint64_t>> partial_offsets(threads);
+	std::vector<std::exception_ptr> errors(threads);
+
+	//Thread i serializes a contiguous range of objects into buffers[i].
+	auto work = [&](unsigned i){
+		try{
+			auto first = (objectid_t)((std::uint64_t)object_count * i / threads) + 1;
+			auto last = (objectid_t)((std::uint64_t)object_count * (i + 1) / threads);
+			StringSink sink(buffers[i]);
+			SerializerStream ss(sink);
+			ss.parent = this;
+			ss.wire_format = this->wire_format;
+			for (auto oid = first; oid <= last; oid++){
+				if (offsets)
+					partial_offsets[i].push_back(sink.size());
+				this->node_map[oid].serialize(ss);
+			}
+		}catch (...){
+			errors[i] = std::current_exception();
+		}
+	};
+
+	{
+		std::vector<std::thread> pool;
+		try{
+			pool.reserve(threads - 1);
+			for (unsigned i = 1; i < threads; i++)
+				pool.emplace_back(work, i);
+		}catch (...){
+			//Couldn't start all the threads. Do the rest of the work here.
+			for (auto i = (unsigned)pool.size() + 1; i < threads; i++)
+				work(i);
+		}
+		work(0);
+		for (auto &t : pool)
+			t.join();
+	}
+	for (auto &e : errors)
+		if (e)
+			std::rethrow_exception(e);
+
+	if (!offsets)
+		return;
+	offsets->reserve((size_t)object_count + 1);
+	std::uint64_t base = 0;
+	for (unsigned i = 0; i < threads; i++){
+		for (auto offset : partial_offsets[i])
+			offsets->push_back(base + offset);
+		base += buffers[i].size();
+	}
+	offsets->push_back(base);
+}
+
+bool SerializerStream::serialize_header(const Serializable &obj, const Options &options){
+	this->wire_format = options.wire_format;
 	auto node = obj.get_object_node();
 #ifdef LOG
 	std::clog << "Traversing reference graph...\n";
 #endif
-	std::set<std::uint32_t> used_types;
-	objectid_t root_object = 0;
-	{
+	if (!this->session){
+		this->next_object_id = 1;
+		this->id_map.clear();
+	}
+	//In a session, node_map only holds the objects of this message, so
+	//node_map[i] is the object with ID session_base + i.
+	this->session_base = this->next_object_id - 1;
+	const auto base = this->session_base;
+	this->node_map.clear();
+	this->node_map.emplace_back();
+	objectid_t root_object = this->id_map.find(node.get_identity());
+	if (root_object){
+		//Sent in an earlier message of the session, along with everything it
+		//points to.
+	}else if (options.traversal_threads > 1){
+		root_object = base + 1;
+		this->traverse_parallel(node, options.traversal_threads);
+	}else{
 		std::vector<decltype(node)> stack, temp_stack;
-		this->id_map[std::make_pair(false, 0)] = 0;
 
+		root_object = base + 1;
 		auto id = this->save_object(node.get_identity());
-		assert(id);
-		root_object = id;
-		this->node_map[id] = node;
-		used_types.insert(node.get_typeid());
+		assert(id == root_object);
+		this->node_map.push_back(node);
 		stack.push_back(node);
 
 		while (stack.size()){
@@ -75,27 +398,49 @@ bool SerializerStream::full_serialization(const Serializable &obj, const Options
 				id = this->save_object(i.get_identity());
 				if (!id)
 					continue;
-				this->node_map[id] = i;
-				used_types.insert(i.get_typeid());
+				this->node_map.push_back(i);
 				stack.push_back(i);
 			}
 			temp_stack.clear();
 		}
 	}
+	//Bitset indexed by type ID.
+	std::vector<bool> used_types;
+	size_t used_type_count = 0;
+	for (size_t i = 1; i < this->node_map.size(); i++){
+		auto type = this->node_map[i].get_typeid();
+		if (type >= used_types.size())
+			used_types.resize(type + 1);
+		if (used_types[type])
+			continue;
+		used_types[type] = true;
+		used_type_count++;
+	}
+	const auto object_count = (objectid_t)(this->node_map.size() - 1);
 	if (options.include_typehashes){
 #ifdef LOG
 		std::clog <<
-			"Traversal found " << this->node_map.size() << " objects.\n"
+			"Traversal found " << object_count << " objects.\n"
 			"Serializing type hashes...\n";
 #endif
-		auto list = obj.get_metadata()->get_known_types();
-		std::map<decltype(list[0].first), decltype(list[0].second) *> typemap;
-		for (auto &i : list)
-			typemap[i.first] = &i.second;
-		this->serialize((std::uint32_t)used_types.size());
-		for (auto &t : used_types){
-			this->serialize(t);
-			this->serialize_array(typemap[t]->digest);
+		auto metadata = obj.get_metadata();
+		this->serialize((std::uint32_t)used_type_count);
+		for (std::uint32_t t = 0; t < used_types.size(); t++){
+			if (!used_types[t])
+				continue;
+			auto hash = metadata->find_type_hash(t);
+			if (!hash)
+				throw UnknownTypeHashException(t);
+			//Keyed by the same IDs as the node map.
+			auto wire_type = t;
+			if (options.type_map){
+				auto it = options.type_map->find(t);
+				if (it == options.type_map->end())
+					return false;
+				wire_type = it->second;
+			}
+			this->serialize(wire_type);
+			this->serialize_array(hash->digest);
 		}
 	}
 
@@ -104,29 +449,32 @@ bool SerializerStream::full_serialization(const Serializable &obj, const Options
 		std::clog << "Remapping object IDs...\n";
 #endif
 
-		std::map<std::uint32_t, std::vector<objectid_t>> remap;
-		for (auto &n : this->node_map)
-			remap[n.second.get_typeid()].push_back(n.first);
-		
-		this->next_object_id = 1;
-		decltype(this->node_map) temp;
-		bool root_set = false;
-		this->id_map.clear();
-		this->id_map[std::make_pair(false, 0)] = 0;
-		for (auto &r : remap){
-			for (auto i : r.second){
-				auto &node = this->node_map[i];
-				if (!node.get_address())
-					continue;
-				auto oid = this->save_object(node.get_identity());
-				if (!root_set && i == root_object){
-					root_object = oid;
-					root_set = true;
-				}
-				temp[oid] = node;
-			}
-		}
+		//Counting sort by type ID. Within a type, objects keep their
+		//discovery order.
+		std::vector<objectid_t> offsets(used_types.size() + 1, 0);
+		for (objectid_t i = 1; i <= object_count; i++)
+			offsets[this->node_map[i].get_typeid() + 1]++;
+		for (size_t i = 1; i < offsets.size(); i++)
+			offsets[i] += offsets[i - 1];
+		//new_ids[old ID] = new ID
+		std::vector<objectid_t> new_ids(object_count + 1);
+		for (objectid_t i = 1; i <= object_count; i++)
+			new_ids[i] = ++offsets[this->node_map[i].get_typeid()];
+
+		decltype(this->node_map) temp(this->node_map.size());
+		for (objectid_t i = 1; i <= object_count; i++)
+			temp[new_ids[i]] = this->node_map[i];
 		this->node_map = std::move(temp);
+		if (!base)
+			this->id_map.remap_values([&new_ids](objectid_t oid){ return new_ids[oid]; });
+		else{
+			//Only the objects of this message. Going through the whole table
+			//would make every message cost as much as the entire session.
+			for (objectid_t i = 1; i <= object_count; i++)
+				this->id_map.assign(this->node_map[i].get_identity(), base + i);
+		}
+		if (root_object > base)
+			root_object = base + new_ids[root_object - base];
 	}
 
 #ifdef LOG
@@ -135,8 +483,8 @@ bool SerializerStream::full_serialization(const Serializable &obj, const Options
 
 	{
 		std::vector<std::pair<std::uint32_t, objectid_t>> type_map;
-		for (auto &[oid, node] : this->node_map){
-			auto type = node.get_typeid();
+		for (objectid_t oid = 1; oid <= object_count; oid++){
+			auto type = this->node_map[oid].get_typeid();
 			if (!type)
 				throw InternalErrorException();
 			if (options.type_map){
@@ -146,10 +494,10 @@ bool SerializerStream::full_serialization(const Serializable &obj, const Options
 				type = it->second;
 			}
 			if (type_map.empty() || type != type_map.back().first){
-				type_map.push_back(std::make_pair(type, oid));
+				type_map.push_back(std::make_pair(type, base + oid));
 				continue;
 			}
-			type_map.back().second = std::max(type_map.back().second, oid);
+			type_map.back().second = std::max(type_map.back().second, base + oid);
 		}
 		this->serialize((wire_size_t)type_map.size());
 		for (auto &i : type_map){
@@ -158,14 +506,103 @@ bool SerializerStream::full_serialization(const Serializable &obj, const Options
 		}
 		this->serialize(root_object);
 	}
+	return true;
+}
+
+bool SerializerStream::full_serialization(const Serializable &obj, const Options &options){
+	if (!this->session)
+		return this->serialize_message(obj, options);
+	//The peer won't get the objects of a message that isn't sent completely.
+	try{
+		if (this->serialize_message(obj, options))
+			return true;
+	}catch (...){
+		this->rollback_session_message();
+		throw;
+	}
+	this->rollback_session_message();
+	return false;
+}
+
+bool SerializerStream::serialize_message(const Serializable &obj, const Options &options){
+	if (!this->serialize_header(obj, options))
+		return false;
+	const auto object_count = (objectid_t)(this->node_map.size() - 1);
 
 #ifdef LOG
 	std::clog << "Serializing nodes...\n";
 #endif
-	for (auto &n : this->node_map)
-		n.second.serialize(*this);
+	if (options.include_offset_table || options.encoding_threads > 1){
+		//The nodes are serialized to temporary buffers first, so that the
+		//offsets are known before the nodes are written, and so that each
+		//thread has its own buffer.
+		std::vector<std::string> buffers;
+		std::vector<std::uint64_t> offsets;
+		this->serialize_nodes_to_buffers(object_count, options.encoding_threads, buffers, options.include_offset_table ? &offsets : nullptr);
+		for (auto offset : offsets)
+			this->serialize_fixed(offset);
+		for (auto &buffer : buffers)
+			this->sink->write(buffer.data(), buffer.size());
+	}else{
+		for (objectid_t oid = 1; oid <= object_count; oid++)
+			this->node_map[oid].serialize(*this);
+	}
+	this->sink->flush();
 #ifdef LOG
 	std::clog << "Serialization done!\n";
 #endif
 	return true;
 }
+
+std::optional<std::uint64_t> SerializerStream::compute_serialized_size(const Serializable &obj, const Options &options){
+	CountingSink counter;
+	auto sink = this->sink;
+	this->sink = &counter;
+	//Nothing is sent, so a session must not remember these objects.
+	auto restore = [this, sink](){
+		this->sink = sink;
+		if (this->session)
+			this->rollback_session_message();
+	};
+	try{
+		if (!this->serialize_header(obj, options)){
+			restore();
+			return {};
+		}
+		const auto object_count = (objectid_t)(this->node_map.size() - 1);
+		std::uint64_t ret = 0;
+		if (options.include_offset_table)
+			ret += sizeof(std::uint64_t) * ((std::uint64_t)object_count + 1);
+		for (objectid_t oid = 1; oid <= object_count; oid++){
+			auto &node = this->node_map[oid];
+			if (node.get_is_serializable())
+				ret += static_cast<const Serializable *>(node.get_address())->serialized_size(*this);
+			else
+				//Strings, containers, etc. pointed to directly.
+				node.serialize(*this);
+		}
+		restore();
+		return ret + counter.size();
+	}catch (...){
+		restore();
+		throw;
+	}
+}
+
+std::uint64_t SerializerStream::serialized_size_id_private(const void *p) const{
+	if (!p)
+		return 1;
+	auto id = this->get_id_map().find(std::make_pair(false, (uintptr_t)p));
+	if (!id)
+		abort();
+	return serialized_size(id);
+}
+
+std::uint64_t SerializerStream::serialized_size_id(const Serializable *p) const{
+	if (!p)
+		return 1;
+	auto id = this->get_id_map().find(std::make_pair(true, (uintptr_t)p->get_id()));
+	if (!id)
+		abort();
+	return serialized_size(id);
+}
@@ -13,10 +13,17 @@
 #include <stack>
 #include <climits>
 #include <array>
+#include <algorithm>
+#include <cassert>
 #define SERIALIZATION_HAVE_STD_OPTIONAL
 #include <optional>
+#include <string>
 #include "serialization_utils.hpp"
+#include "OutputSink.hpp"
 #include "noexcept.hpp"
+#include "varint.hpp"
+#include "block_codec.hpp"
+#include "gorilla.hpp"
 
 class Serializable;
 
@@ -27,6 +34,15 @@ public:
 	}
 };
 
+class UnknownTypeHashException : public std::exception{
+	std::string message;
+public:
+	UnknownTypeHashException(std::uint32_t type_id): message("The metadata has no type hash for type ID " + std::to_string(type_id) + "."){}
+	const char *what() const NOEXCEPT override{
+		return this->message.c_str();
+	}
+};
+
 template <typename T>
 typename std::make_unsigned<T>::type ints_to_uints(T z){
 	typedef typename std::make_unsigned<T>::type u;
@@ -75,18 +91,135 @@ struct is_built_in_type{
 	static const bool value = std::is_integral<T>::value || std::is_pointer<T>::value || std::is_floating_point<T>::value || std::is_enum<T>::value;
 };
 
+//Open-addressing (linear probing) hash table from object identities (see
+//ObjectNode::get_identity()) to object IDs. Object ID 0 marks empty slots, so
+//it can't be stored.
+class IdentityMap{
+public:
+	typedef std::uint32_t objectid_t;
+	typedef std::pair<bool, uintptr_t> identity_t;
+private:
+	struct Entry{
+		uintptr_t key;
+		objectid_t value;
+		std::uint32_t is_serializable;
+	};
+	std::vector<Entry> table;
+	size_t count = 0;
+	size_t mask = 0;
+
+public:
+	static size_t hash(const identity_t &id){
+		std::uint64_t x = (std::uint64_t)id.second ^ ((std::uint64_t)id.first << 63);
+		x ^= x >> 29;
+		x *= 0xBF58476D1CE4E5B9ULL;
+		x ^= x >> 32;
+		return (size_t)x;
+	}
+private:
+	size_t find_slot(const identity_t &id) const{
+		auto i = hash(id) & this->mask;
+		while (true){
+			auto &e = this->table[i];
+			if (!e.value || (e.key == id.second && !!e.is_serializable == id.first))
+				return i;
+			i = (i + 1) & this->mask;
+		}
+	}
+	void rehash(size_t capacity);
+public:
+	IdentityMap(){
+		this->rehash(64);
+	}
+	size_t size() const{
+		return this->count;
+	}
+	void clear();
+	void reserve(size_t n);
+	//Returns null_oid if not found.
+	objectid_t find(const identity_t &id) const{
+		return this->table[this->find_slot(id)].value;
+	}
+	//Returns false and does nothing if the identity is already present.
+	bool insert(const identity_t &id, objectid_t value);
+	//Does nothing if the identity isn't present.
+	void erase(const identity_t &id);
+	//The identity must be present.
+	void assign(const identity_t &id, objectid_t value){
+		auto &e = this->table[this->find_slot(id)];
+		assert(e.value);
+		e.value = value;
+	}
+	//Replaces every value v with f(v).
+	template <typename F>
+	void remap_values(const F &f){
+		for (auto &e : this->table)
+			if (e.value)
+				e.value = f(e.value);
+	}
+};
+
 class SerializerStream{
 	typedef std::uint32_t objectid_t;
 	static const objectid_t null_oid = 0;
 	objectid_t next_object_id;
-	std::map<std::pair<bool, uintptr_t>, objectid_t> id_map;
-	std::map<objectid_t, ObjectNode> node_map;
-	std::ostream *stream;
+	IdentityMap id_map;
+	bool session = false;
+	//Number of objects sent in earlier messages of the session. The objects
+	//of the current message get the IDs that follow.
+	objectid_t session_base = 0;
+	//Options::wire_format of the current message.
+	std::uint32_t wire_format = 0;
+	//Set on the streams that encode object bodies in parallel. Object IDs
+	//are looked up in the parent.
+	const SerializerStream *parent = nullptr;
+	//Indexed by object ID. Element 0 is unused.
+	std::vector<ObjectNode> node_map;
+	std::unique_ptr<OstreamSink> owned_sink;
+	OutputSink *sink;
+	//Reused by the encoders that can't write straight into the sink.
+	std::vector<std::uint8_t> scratch;
 
 	objectid_t get_new_oid();
 	objectid_t save_object(const std::pair<bool, uintptr_t> &p);
+	const IdentityMap &get_id_map() const{
+		return this->parent ? this->parent->id_map : this->id_map;
+	}
+	void traverse_parallel(const ObjectNode &root, unsigned threads);
+	//Forgets the objects of a message that wasn't sent.
+	void rollback_session_message();
+	void serialize_nodes_to_buffers(objectid_t object_count, unsigned threads, std::vector<std::string> &buffers, std::vector<std::uint64_t> *offsets);
 	void serialize_id_private(const void *p);
 	template <typename T>
+	void serialize_block(const T *data, size_t n){
+		this->serialize((wire_size_t)n);
+		if (!n)
+			return;
+		auto max_size = block_codec::max_encoded_size<T>(n);
+		auto dst = this->sink->try_reserve(max_size);
+		if (dst){
+			this->sink->commit(dst + block_codec::encode(data, n, dst));
+			return;
+		}
+		auto buffer = this->get_scratch(max_size);
+		this->sink->write(buffer, block_codec::encode(data, n, buffer));
+	}
+	std::uint8_t *get_scratch(size_t n){
+		if (this->scratch.size() < n)
+			this->scratch.resize(n);
+		return this->scratch.data();
+	}
+	template <typename T>
+	std::uint64_t serialized_size_block(const T *data, size_t n) const{
+		return this->serialized_size((wire_size_t)n) + block_codec::encoded_size(data, n);
+	}
+	bool use_block_codec() const{
+		return !!(this->wire_format & wire_flags::block_integers);
+	}
+	bool use_key_deltas() const{
+		return !!(this->wire_format & wire_flags::sorted_key_deltas);
+	}
+	template <typename T>
 	typename std::enable_if<is_built_in_type<T>::value, void>::type
 	serialize_id(const T *p){
 		this->serialize_id_private(p);
@@ -98,15 +231,63 @@ class SerializerStream{
 		this->serialize_id_private(p);
 	}
 	void serialize_id(const Serializable *p);
+	std::uint64_t serialized_size_id_private(const void *p) const;
+	template <typename T>
+	typename std::enable_if<is_built_in_type<T>::value, std::uint64_t>::type
+	serialized_size_id(const T *p) const{
+		return this->serialized_size_id_private(p);
+	}
+	std::uint64_t serialized_size_id(const std::string *p) const{
+		return this->serialized_size_id_private(p);
+	}
+	std::uint64_t serialized_size_id(const std::wstring *p) const{
+		return this->serialized_size_id_private(p);
+	}
+	std::uint64_t serialized_size_id(const Serializable *p) const;
 public:
 	SerializerStream(std::ostream &);
+	SerializerStream(OutputSink &);
+	~SerializerStream();
+	//full_serialization() flushes automatically. Only needed after serializing
+	//values directly.
+	void flush(){
+		this->sink->flush();
+	}
+	//From now on, every object full_serialization() sends is remembered, and
+	//later messages only include the objects that haven't been sent yet. The
+	//rest are referred to by the IDs they were sent with. The messages must be
+	//decoded in order by a single DeserializerStream, with
+	//full_deserialization_session().
+	//Objects must not change once they've been sent; to send a new version of
+	//an object, send a new object. Objects that aren't Serializables, such as
+	//strings pointed to directly, are identified by their address, so they
+	//must live as long as the session.
+	void begin_session();
+	bool in_session() const{
+		return this->session;
+	}
 	class Options{
 	public:
 		bool include_typehashes = false;
 		//native type ID -> protocol type ID
 		const std::unordered_map<std::uint32_t, std::uint32_t> *type_map = nullptr;
 		bool remap_object_ids = true;
+		//Writes the byte offset of every object after the node map, so that
+		//the message can be read with a LazyDeserializer.
+		bool include_offset_table = false;
+		//Object bodies are encoded on this many threads. The output is the
+		//same regardless.
+		unsigned encoding_threads = 1;
+		//The reference graph is traversed on this many threads. The output is
+		//the same regardless.
+		unsigned traversal_threads = 1;
+		//A combination of wire_flags.
+		std::uint32_t wire_format = 0;
 	};
+private:
+	bool serialize_header(const Serializable &obj, const Options &);
+	bool serialize_message(const Serializable &obj, const Options &);
+public:
 	//Returns false if the serialization could not be performed.
 	bool full_serialization(const Serializable &obj, const Options &);
 	void full_serialization(const Serializable &obj){
@@ -120,6 +301,13 @@ public:
 		Options o{ false, &type_map };
 		return this->full_serialization(obj, o);
 	}
+	//Returns the exact number of bytes full_serialization() would produce
+	//with the same options, without producing them. Returns nothing if the
+	//serialization could not be performed.
+	std::optional<std::uint64_t> compute_serialized_size(const Serializable &obj, const Options &);
+	std::optional<std::uint64_t> compute_serialized_size(const Serializable &obj){
+		return this->compute_serialized_size(obj, {});
+	}
 	template <typename T>
 	void serialize(const T *t){
 		this->serialize_id(t);
@@ -134,33 +322,68 @@ public:
 	}
 	template <typename T, size_t N>
 	void serialize_array(const T (&array)[N]){
+		if constexpr (std::is_floating_point_v<T>){
+			this->serialize_floats(array, N);
+			return;
+		}
 		for (const auto &e : array)
 			this->serialize(e);
 	}
 	template <typename T, size_t N>
 	void serialize(const std::array<T, N> &array){
+		if constexpr (std::is_floating_point_v<T>){
+			this->serialize_floats(array.data(), N);
+			return;
+		}
 		for (const auto &e : array)
 			this->serialize(e);
 	}
 	void serialize(std::uint8_t c){
-		this->stream->write((const char *)&c, 1);
+		this->sink->put(c);
 	}
 	void serialize(bool b){
 		this->serialize((std::uint8_t)b);
 	}
 	void serialize(std::int8_t c){
-		this->stream->write((const char *)&c, 1);
+		this->sink->put((std::uint8_t)c);
 	}
 	template <typename T>
 	typename std::enable_if<std::is_unsigned<T>::value, void>::type serialize_fixed(T n){
 		static_assert(CHAR_BIT == 8, "Only 8-bit byte platforms supported!");
 
+#ifndef SERIALIZATION_BIG_ENDIAN
+		this->sink->write(&n, sizeof(n));
+#else
 		std::uint8_t array[sizeof(n)];
 		for (auto &i : array){
 			i = n & 0xFF;
 			n >>= 8;
 		}
-		this->stream->write((const char *)array, sizeof(array));
+		this->sink->write(array, sizeof(array));
+#endif
+	}
+	//Writes n values the same way serialize() would one at a time.
+	template <typename T>
+	void serialize_floats(const T *p, size_t n){
+		static_assert(std::numeric_limits<T>::is_iec559, "Only iec559 float/doubles supported!");
+		typedef typename floating_point_mapping<T>::type U;
+		static_assert(sizeof(U) == sizeof(T), "Hard-coded integer type doesn't match the size of requested float type!");
+#ifndef SERIALIZATION_BIG_ENDIAN
+		this->sink->write(p, n * sizeof(T));
+#else
+		U buffer[256];
+		while (n){
+			auto m = std::min<size_t>(n, 256);
+			for (size_t i = 0; i < m; i++){
+				U u;
+				memcpy(&u, p + i, sizeof(u));
+				buffer[i] = byte_swap(u);
+			}
+			this->sink->write(buffer, m * sizeof(U));
+			p += m;
+			n -= m;
+		}
+#endif
 	}
 	template <typename T>
 	typename std::enable_if<std::is_signed<T>::value && std::is_integral<T>::value, void>::type serialize(T z){
@@ -169,15 +392,21 @@ public:
 	template <typename T>
 	typename std::enable_if<std::is_unsigned<T>::value, void>::type serialize(T n){
 		static_assert(CHAR_BIT == 8, "Only 8-bit byte platforms supported!");
+		static_assert(sizeof(T) <= sizeof(std::uint64_t), "Integer type too large!");
 
-		if (!n){
-			this->serialize((std::uint8_t)0);
+		if (this->wire_format & wire_flags::prefix_varints){
+			std::uint8_t buffer[prefix_varint::max_length];
+			this->sink->write(buffer, prefix_varint::encode(buffer, n));
+			return;
+		}
+		if (n < 0x80){
+			this->sink->put((std::uint8_t)n);
 			return;
 		}
 
 		const unsigned shift = 7;
-		const size_t capacity = (sizeof(n) * 8 + 6) / 7 * 2;
-		std::uint8_t buffer[capacity]; //times 2 for safety
+		const size_t capacity = (sizeof(n) * 8 + 6) / 7;
+		std::uint8_t buffer[capacity] = {};
 		const std::uint8_t mask = 0x7F;
 
 		size_t buffer_size = 0;
@@ -185,12 +414,11 @@ public:
 		while (n > 0){
 			std::uint8_t m = n & mask;
 			n >>= shift;
-			m &= mask;
 			m |= ~mask;
 			buffer[capacity - 1 - buffer_size++] = m;
 		}
 		buffer[capacity - 1] &= mask;
-		this->stream->write((const char *)buffer + (capacity - buffer_size), buffer_size);
+		this->sink->write(buffer + (capacity - buffer_size), buffer_size);
 	}
 	template <typename T>
 	typename std::enable_if<std::is_floating_point<T>::value, void>::type serialize(T x){
@@ -206,14 +434,25 @@ public:
 	}
 	void serialize(const std::string &s){
 		this->serialize((wire_size_t)s.size());
-		this->stream->write(s.data(), s.size());
+		this->sink->write_in_place(s.data(), s.size());
 	}
 	template <typename T>
 	void serialize(const std::basic_string<T> &s){
+		if constexpr (block_codec::is_block_integer<T>::value){
+			if (this->use_block_codec()){
+				this->serialize_block(s.data(), s.size());
+				return;
+			}
+		}
 		this->serialize((wire_size_t)s.size());
 		for (typename std::make_unsigned<T>::type c : s)
 			this->serialize(c);
 	}
+	template <typename T>
+	void serialize(const buffer_view<T> &v){
+		this->serialize((wire_size_t)v.size());
+		this->sink->write_in_place(v.data(), v.size());
+	}
 	template <typename It>
 	void serialize_sequence(It begin, It end, size_t length){
 		this->serialize((wire_size_t)length);
@@ -232,15 +471,64 @@ public:
 	std::enable_if_t<std::is_same_v<T, std::uint8_t> || std::is_same_v<T, std::int8_t>, void>
 	serialize(const std::vector<T> &v){
 		this->serialize((wire_size_t)v.size());
-		this->stream->write((const char *)v.data(), v.size());
+		this->sink->write_in_place(v.data(), v.size());
 	}
 	template <typename T>
 	std::enable_if_t<!(std::is_same_v<T, std::uint8_t> || std::is_same_v<T, std::int8_t>), void>
 	serialize(const std::vector<T> &v){
+		if constexpr (std::is_floating_point_v<T>){
+			this->serialize((wire_size_t)v.size());
+			this->serialize_floats(v.data(), v.size());
+			return;
+		}
+		if constexpr (block_codec::is_block_integer<T>::value){
+			if (this->use_block_codec()){
+				this->serialize_block(v.data(), v.size());
+				return;
+			}
+		}
 		this->serialize_sequence(v.begin(), v.end(), v.size());
 	}
+	//For members declared as gorilla. The size of the vector and the size of
+	//the encoded data are written first.
+	void serialize_gorilla(const std::vector<double> &v){
+		//The size goes before the data, so the data is encoded first.
+		auto buffer = this->get_scratch(gorilla::max_encoded_size(v.size()));
+		auto size = gorilla::encode(v.data(), v.size(), buffer);
+		this->serialize((wire_size_t)v.size());
+		this->serialize((wire_size_t)size);
+		this->sink->write(buffer, size);
+	}
+	//Like serialize_sequence() and serialize_maplike(), for std::sets and
+	//std::maps with integer keys, with wire_flags::sorted_key_deltas.
+	template <typename Container>
+	void serialize_key_deltas(const Container &c){
+		typedef typename Container::key_type K;
+		this->serialize((wire_size_t)c.size());
+		const K *previous = nullptr;
+		for (auto &x : c){
+			const K *key;
+			if constexpr (is_maplike<Container>::value)
+				key = &x.first;
+			else
+				key = &x;
+			if (previous)
+				this->serialize(ordered_key_gap(*previous, *key));
+			else
+				this->serialize(*key);
+			if constexpr (is_maplike<Container>::value)
+				this->serialize(x.second);
+			previous = key;
+		}
+	}
 	template <typename T>
 	void serialize(const std::set<T> &s){
+		if constexpr (is_delta_key<T>::value){
+			if (this->use_key_deltas()){
+				this->serialize_key_deltas(s);
+				return;
+			}
+		}
 		this->serialize_sequence(s.begin(), s.end(), s.size());
 	}
 	template <typename T>
@@ -249,6 +537,12 @@ public:
 	}
 	template <typename T1, typename T2>
 	void serialize(const std::map<T1, T2> &s){
+		if constexpr (is_delta_key<T1>::value){
+			if (this->use_key_deltas()){
+				this->serialize_key_deltas(s);
+				return;
+			}
+		}
 		this->serialize_maplike(s.begin(), s.end(), s.size());
 	}
 	template <typename T1, typename T2>
@@ -273,4 +567,173 @@ public:
 		this->serialize(true);
 		this->serialize(*o);
 	}
+
+	//serialized_size(x) returns the number of bytes serialize(x) writes. Only
+	//valid while serializing or measuring a message, since pointers must
+	//already have been assigned IDs.
+	template <typename T>
+	std::uint64_t serialized_size(const T *t) const{
+		return this->serialized_size_id(t);
+	}
+	template <typename T>
+	std::uint64_t serialized_size(const std::unique_ptr<T> &t) const{
+		return this->serialized_size_id(t.get());
+	}
+	template <typename T>
+	std::uint64_t serialized_size(const std::shared_ptr<T> &t) const{
+		return this->serialized_size_id(t.get());
+	}
+	template <typename T, size_t N>
+	std::uint64_t serialized_size_array(const T (&array)[N]) const{
+		std::uint64_t ret = 0;
+		for (const auto &e : array)
+			ret += this->serialized_size(e);
+		return ret;
+	}
+	template <typename T, size_t N>
+	std::uint64_t serialized_size(const std::array<T, N> &array) const{
+		if constexpr (std::is_floating_point_v<T>)
+			return N * this->serialized_size(T());
+		std::uint64_t ret = 0;
+		for (const auto &e : array)
+			ret += this->serialized_size(e);
+		return ret;
+	}
+	std::uint64_t serialized_size(std::uint8_t) const{
+		return 1;
+	}
+	std::uint64_t serialized_size(bool) const{
+		return 1;
+	}
+	std::uint64_t serialized_size(std::int8_t) const{
+		return 1;
+	}
+	template <typename T>
+	typename std::enable_if<std::is_signed<T>::value && std::is_integral<T>::value, std::uint64_t>::type serialized_size(T z) const{
+		return this->serialized_size(ints_to_uints(z));
+	}
+	template <typename T>
+	typename std::enable_if<std::is_unsigned<T>::value, std::uint64_t>::type serialized_size(T n) const{
+		if (this->wire_format & wire_flags::prefix_varints)
+			return prefix_varint::encoded_length(n);
+		std::uint64_t ret = 1;
+		for (n >>= 7; n; n >>= 7)
+			ret++;
+		return ret;
+	}
+	template <typename T>
+	typename std::enable_if<std::is_floating_point<T>::value, std::uint64_t>::type serialized_size(T) const{
+		return sizeof(typename floating_point_mapping<T>::type);
+	}
+	std::uint64_t serialized_size(const std::string &s) const{
+		return this->serialized_size((wire_size_t)s.size()) + s.size();
+	}
+	template <typename T>
+	std::uint64_t serialized_size(const std::basic_string<T> &s) const{
+		if constexpr (block_codec::is_block_integer<T>::value)
+			if (this->use_block_codec())
+				return this->serialized_size_block(s.data(), s.size());
+		auto ret = this->serialized_size((wire_size_t)s.size());
+		for (typename std::make_unsigned<T>::type c : s)
+			ret += this->serialized_size(c);
+		return ret;
+	}
+	template <typename T>
+	std::uint64_t serialized_size(const buffer_view<T> &v) const{
+		return this->serialized_size((wire_size_t)v.size()) + v.size();
+	}
+	template <typename It>
+	std::uint64_t serialized_size_sequence(It begin, It end, size_t length) const{
+		auto ret = this->serialized_size((wire_size_t)length);
+		typedef typename std::iterator_traits<It>::value_type T;
+		if constexpr (std::is_floating_point_v<T>)
+			return ret + length * this->serialized_size(T());
+		for (; begin != end; ++begin)
+			ret += this->serialized_size(*begin);
+		return ret;
+	}
+	template <typename It>
+	std::uint64_t serialized_size_maplike(It begin, It end, size_t length) const{
+		auto ret = this->serialized_size((wire_size_t)length);
+		for (; begin != end; ++begin){
+			ret += this->serialized_size(begin->first);
+			ret += this->serialized_size(begin->second);
+		}
+		return ret;
+	}
+	template <typename Container>
+	std::uint64_t serialized_size_key_deltas(const Container &c) const{
+		typedef typename Container::key_type K;
+		auto ret = this->serialized_size((wire_size_t)c.size());
+		const K *previous = nullptr;
+		for (auto &x : c){
+			const K *key;
+			if constexpr (is_maplike<Container>::value)
+				key = &x.first;
+			else
+				key = &x;
+			if (previous)
+				ret += this->serialized_size(ordered_key_gap(*previous, *key));
+			else
+				ret += this->serialized_size(*key);
+			if constexpr (is_maplike<Container>::value)
+				ret += this->serialized_size(x.second);
+			previous = key;
+		}
+		return ret;
+	}
+	template <typename T>
+	std::enable_if_t<std::is_same_v<T, std::uint8_t> || std::is_same_v<T, std::int8_t>, std::uint64_t>
+	serialized_size(const std::vector<T> &v) const{
+		return this->serialized_size((wire_size_t)v.size()) + v.size();
+	}
+	template <typename T>
+	std::enable_if_t<!(std::is_same_v<T, std::uint8_t> || std::is_same_v<T, std::int8_t>), std::uint64_t>
+	serialized_size(const std::vector<T> &v) const{
+		if constexpr (block_codec::is_block_integer<T>::value)
+			if (this->use_block_codec())
+				return this->serialized_size_block(v.data(), v.size());
+		return this->serialized_size_sequence(v.begin(), v.end(), v.size());
+	}
+	std::uint64_t serialized_size_gorilla(const std::vector<double> &v) const{
+		auto size = gorilla::encoded_size(v.data(), v.size());
+		return this->serialized_size((wire_size_t)v.size()) + this->serialized_size((wire_size_t)size) + size;
+	}
+	template <typename T>
+	std::uint64_t serialized_size(const std::set<T> &s) const{
+		if constexpr (is_delta_key<T>::value)
+			if (this->use_key_deltas())
+				return this->serialized_size_key_deltas(s);
+		return this->serialized_size_sequence(s.begin(), s.end(), s.size());
+	}
+	template <typename T>
+	std::uint64_t serialized_size(const std::unordered_set<T> &s) const{
+		return this->serialized_size_sequence(s.begin(), s.end(), s.size());
+	}
+	template <typename T1, typename T2>
+	std::uint64_t serialized_size(const std::map<T1, T2> &s) const{
+		if constexpr (is_delta_key<T1>::value)
+			if (this->use_key_deltas())
+				return this->serialized_size_key_deltas(s);
+		return this->serialized_size_maplike(s.begin(), s.end(), s.size());
+	}
+	template <typename T1, typename T2>
+	std::uint64_t serialized_size(const std::unordered_map<T1, T2> &s) const{
+		return this->serialized_size_maplike(s.begin(), s.end(), s.size());
+	}
+	template <typename T>
+	typename std::enable_if<std::is_base_of<Serializable, T>::value, std::uint64_t>::type serialized_size(const T &serializable) const{
+		return serializable.serialized_size(*this);
+	}
+	template <typename T>
+	std::enable_if_t<std::is_enum_v<T>, std::uint64_t>
+	serialized_size(T t) const{
+		return this->serialized_size((std::underlying_type_t<T>)t);
+	}
+	template <typename T>
+	std::uint64_t serialized_size(const std::optional<T> &o) const{
+		if (!o)
+			return 1;
+		return 1 + this->serialized_size(*o);
+	}
 };
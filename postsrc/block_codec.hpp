@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include "varint.hpp"
+//MSVC doesn't define __SSE4_1__, but /arch:AVX implies it.
+#if defined __SSE4_1__ || defined __AVX__
+#define SERIALIZATION_BLOCK_CODEC_SSE41
+#include <smmintrin.h>
+#endif
+
+//Block codec for arrays of 16, 32 and 64 bit integers, from the Stream VByte
+//family. The lengths of the values (in bytes, without leading zero bytes) are
+//written first, packed in control bytes, followed by the values themselves,
+//little endian. Since the lengths of a whole group are known up front, the
+//decoder can expand a group with a single shuffle (SSE4.1). Decoding is bound
+//by the dependency on the position of the next group, so wider vectors don't
+//help; without SSE4.1, each value is read with one 8 byte load and a mask.
+//Values of up to 32 bits use 2 bits per length, four to a control byte. 64
+//bit values use 4 bits per length, two to a control byte. Signed values are
+//zigzag-encoded first. The lengths of the unused slots of the last control
+//byte are zero.
+namespace block_codec{
+
+template <typename T>
+struct is_block_integer{
+	static const bool value =
+		std::is_integral<T>::value &&
+		!std::is_same<T, bool>::value &&
+		(sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+};
+
+template <typename T>
+using unsigned_t = typename std::conditional<sizeof(T) == 8, std::uint64_t, std::uint32_t>::type;
+
+//Values per control byte.
+template <typename T>
+constexpr size_t group_size(){
+	return sizeof(T) == 8 ? 2 : 4;
+}
+
+template <typename T>
+unsigned_t<T> to_unsigned(T x){
+	typedef typename std::make_unsigned<T>::type U;
+	if constexpr (std::is_signed<T>::value)
+		return x >= 0 ? (U)x * 2 : (U)-(x + 1) * 2 + 1;
+	else
+		return (U)x;
+}
+
+template <typename T>
+T from_unsigned(unsigned_t<T> x){
+	if constexpr (std::is_signed<T>::value)
+		return (T)((x & 1) ? -(T)(x >> 1) - 1 : (T)(x >> 1));
+	else
+		return (T)x;
+}
+
+inline unsigned byte_length(std::uint64_t x){
+	unsigned ret = 1;
+	while (ret < 8 && x >> (ret * 8))
+		ret++;
+	return ret;
+}
+
+struct Tables{
+	//Bytes of data described by a control byte of 32 bit lengths.
+	std::uint8_t lengths32[256];
+	//Same, for 64 bit lengths.
+	std::uint8_t lengths64[256];
+	//pshufb masks that expand the data of a control byte of 32 bit lengths
+	//into four 32 bit values.
+	std::uint8_t shuffles[256][16];
+};
+
+constexpr Tables make_tables(){
+	Tables ret{};
+	for (unsigned c = 0; c < 256; c++){
+		unsigned offset = 0;
+		for (unsigned i = 0; i < 4; i++){
+			unsigned length = ((c >> (i * 2)) & 3) + 1;
+			for (unsigned j = 0; j < 4; j++)
+				ret.shuffles[c][i * 4 + j] = j < length ? (std::uint8_t)(offset + j) : 0x80;
+			offset += length;
+		}
+		ret.lengths32[c] = (std::uint8_t)offset;
+		ret.lengths64[c] = (std::uint8_t)((c & 15) + (c >> 4) + 2);
+	}
+	return ret;
+}
+
+inline constexpr Tables tables = make_tables();
+
+template <typename T>
+size_t control_size(size_t n){
+	return (n + group_size<T>() - 1) / group_size<T>();
+}
+
+//Upper bound for encode().
+template <typename T>
+size_t max_encoded_size(size_t n){
+	return control_size<T>(n) + n * sizeof(T);
+}
+
+template <typename T>
+size_t encoded_size(const T *src, size_t n){
+	size_t ret = control_size<T>(n);
+	for (size_t i = 0; i < n; i++)
+		ret += byte_length(to_unsigned(src[i]));
+	return ret;
+}
+
+//Returns the number of bytes written.
+template <typename T>
+size_t encode(const T *src, size_t n, std::uint8_t *dst){
+	const auto group = group_size<T>();
+	const unsigned bits = 8 / group;
+	auto control = dst;
+	auto data = dst + control_size<T>(n);
+	for (size_t i = 0; i < n; i += group){
+		std::uint8_t c = 0;
+		for (size_t j = 0; j < group && i + j < n; j++){
+			auto x = to_unsigned(src[i + j]);
+			auto length = byte_length(x);
+			c |= (std::uint8_t)((length - 1) << (j * bits));
+			for (unsigned k = 0; k < length; k++, x >>= 8)
+				*data++ = (std::uint8_t)x;
+		}
+		*control++ = c;
+	}
+	return data - dst;
+}
+
+//Bytes of data that follow the control bytes of n values.
+template <typename T>
+size_t data_size(const std::uint8_t *control, size_t n){
+	const auto group = group_size<T>();
+	auto &lengths = sizeof(T) == 8 ? tables.lengths64 : tables.lengths32;
+	size_t ret = 0;
+	for (size_t i = 0; i < n / group; i++)
+		ret += lengths[control[i]];
+	if (n % group){
+		//Unused slots are counted as one byte each.
+		ret += lengths[control[n / group]] - (group - n % group);
+	}
+	return ret;
+}
+
+namespace detail{
+
+template <typename T>
+void decode_scalar(const std::uint8_t *control, const std::uint8_t *data, const std::uint8_t *end, size_t first, size_t n, T *dst){
+	const auto group = group_size<T>();
+	const unsigned bits = 8 / group;
+	const unsigned mask = (1 << bits) - 1;
+	for (size_t i = first; i < n; i++){
+		auto length = ((control[i / group] >> (i % group * bits)) & mask) + 1;
+		std::uint64_t x = 0;
+		if (end - data >= 8){
+			x = prefix_varint::load_little_endian(data);
+			if (length < 8)
+				x &= ((std::uint64_t)1 << (length * 8)) - 1;
+		}else{
+			for (unsigned k = length; k--;)
+				x = x << 8 | data[k];
+		}
+		data += length;
+		dst[i] = from_unsigned<T>((unsigned_t<T>)x);
+	}
+}
+
+#ifdef SERIALIZATION_BLOCK_CODEC_SSE41
+template <typename T>
+__m128i zigzag_decode(__m128i x){
+	if constexpr (std::is_signed<T>::value)
+		return _mm_xor_si128(_mm_srli_epi32(x, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(x, _mm_set1_epi32(1))));
+	else
+		return x;
+}
+
+//Four values from one control byte. There must be 16 readable bytes at data.
+template <typename T>
+void decode_group(std::uint8_t c, const std::uint8_t *data, T *dst){
+	auto x = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)data), _mm_loadu_si128((const __m128i *)tables.shuffles[c]));
+	x = zigzag_decode<T>(x);
+	if constexpr (sizeof(T) == 4)
+		_mm_storeu_si128((__m128i *)dst, x);
+	else if constexpr (std::is_signed<T>::value)
+		_mm_storel_epi64((__m128i *)dst, _mm_packs_epi32(x, x));
+	else
+		_mm_storel_epi64((__m128i *)dst, _mm_packus_epi32(x, x));
+}
+#endif
+
+}
+
+//Decodes n values. data_size must be the result of data_size(control, n);
+//nothing past data + data_size is read.
+template <typename T>
+void decode(const std::uint8_t *control, const std::uint8_t *data, size_t data_size, size_t n, T *dst){
+	size_t i = 0;
+	auto end = data + data_size;
+#ifdef SERIALIZATION_BLOCK_CODEC_SSE41
+	if constexpr (sizeof(T) <= 4){
+		for (; i + 4 <= n && end - data >= 16; i += 4){
+			auto c = control[i / 4];
+			detail::decode_group(c, data, dst + i);
+			data += tables.lengths32[c];
+		}
+	}
+#endif
+	detail::decode_scalar(control, data, end, i, n, dst);
+}
+
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+//Read-only view of a string or byte array, used for the string_view and
+//bytes_view types. When it's deserialized from a source that can lend its
+//memory (see InputSource::get_owner()) the view points straight into the
+//input buffer; otherwise it points into a private copy. Either way the view
+//shares ownership of whatever it points into, so it never dangles.
+template <typename T>
+class buffer_view{
+	static_assert(sizeof(T) == 1, "buffer_view only supports byte-sized elements.");
+	const T *pointer = nullptr;
+	size_t length = 0;
+	std::shared_ptr<const void> owner;
+public:
+	typedef T value_type;
+	typedef const T *const_iterator;
+	typedef const T *iterator;
+
+	buffer_view() = default;
+	//owner must keep [data, data + size) alive. It may be null if the memory
+	//outlives the view by other means.
+	buffer_view(const T *data, size_t size, std::shared_ptr<const void> owner): pointer(data), length(size), owner(std::move(owner)){}
+	static buffer_view copy_of(const void *data, size_t size){
+		if (!size)
+			return {};
+		std::shared_ptr<T> copy(new T[size], std::default_delete<T[]>());
+		memcpy(copy.get(), data, size);
+		auto p = copy.get();
+		return buffer_view(p, size, std::move(copy));
+	}
+	static buffer_view copy_of(const std::basic_string_view<T> &s){
+		return copy_of(s.data(), s.size());
+	}
+	const T *data() const{
+		return this->pointer;
+	}
+	size_t size() const{
+		return this->length;
+	}
+	bool empty() const{
+		return !this->length;
+	}
+	const T *begin() const{
+		return this->pointer;
+	}
+	const T *end() const{
+		return this->pointer + this->length;
+	}
+	const T &operator[](size_t i) const{
+		return this->pointer[i];
+	}
+	std::basic_string_view<T> view() const{
+		return std::basic_string_view<T>(this->pointer, this->length);
+	}
+	operator std::basic_string_view<T>() const{
+		return this->view();
+	}
+	const std::shared_ptr<const void> &get_owner() const{
+		return this->owner;
+	}
+	bool operator==(const buffer_view &other) const{
+		return this->view() == other.view();
+	}
+	bool operator!=(const buffer_view &other) const{
+		return !(*this == other);
+	}
+	bool operator<(const buffer_view &other) const{
+		return this->view() < other.view();
+	}
+};
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include "varint.hpp"
+
+//XOR codec for series of doubles that change slowly, as in Facebook's
+//Gorilla. The first value is written as is. Every following value is XORed
+//with the one before it and written as one of:
+//  0                the XOR is zero; the value repeats.
+//  1 0 bits         the meaningful bits of the XOR fit in the current window
+//                   (the leading and trailing zeros of the last window
+//                   written); only the bits in the window are written.
+//  1 1 l m bits     a new window: 5 bits for the number of leading zeros (at
+//                   most 31), 6 bits for the number of meaningful bits (64 is
+//                   written as 0), then the meaningful bits.
+//Bits are packed from the least significant bit of each byte up, and the last
+//byte is padded with zeros.
+namespace gorilla{
+
+namespace detail{
+
+inline std::uint64_t to_bits(double x){
+	std::uint64_t ret;
+	memcpy(&ret, &x, sizeof(ret));
+	return ret;
+}
+
+inline double from_bits(std::uint64_t x){
+	double ret;
+	memcpy(&ret, &x, sizeof(ret));
+	return ret;
+}
+
+//x must not be zero.
+inline unsigned count_trailing_zeros(std::uint64_t x){
+	auto low = (std::uint32_t)x;
+	if (low)
+		return prefix_varint::count_trailing_zeros(low);
+	return 32 + prefix_varint::count_trailing_zeros((std::uint32_t)(x >> 32));
+}
+
+class BitCounter{
+	std::uint64_t bits = 0;
+public:
+	void write(std::uint64_t, unsigned n){
+		this->bits += n;
+	}
+	std::uint64_t get_bits() const{
+		return this->bits;
+	}
+};
+
+class BitWriter{
+	std::uint8_t *dst;
+	std::uint64_t buffer = 0;
+	unsigned bits = 0;
+public:
+	BitWriter(std::uint8_t *dst): dst(dst){}
+	//x must fit in n bits. n can be 0 to 64.
+	void write(std::uint64_t x, unsigned n){
+		if (!n)
+			return;
+		this->buffer |= x << this->bits;
+		if (this->bits + n < 64){
+			this->bits += n;
+			return;
+		}
+		for (unsigned i = 0; i < 8; i++)
+			*this->dst++ = (std::uint8_t)(this->buffer >> (i * 8));
+		this->buffer = this->bits ? x >> (64 - this->bits) : 0;
+		this->bits = this->bits + n - 64;
+	}
+	//Returns the end of the output.
+	std::uint8_t *finish(){
+		for (; this->bits; this->bits -= this->bits < 8 ? this->bits : 8){
+			*this->dst++ = (std::uint8_t)this->buffer;
+			this->buffer >>= 8;
+		}
+		return this->dst;
+	}
+};
+
+class BitReader{
+	const std::uint8_t *data;
+	size_t size;
+	size_t position = 0;
+public:
+	BitReader(const std::uint8_t *data, size_t size): data(data), size(size){}
+	//Returns false if there aren't n bits left. n can be 0 to 64.
+	bool read(std::uint64_t &dst, unsigned n){
+		if (n > this->remaining())
+			return false;
+		if (!n){
+			dst = 0;
+			return true;
+		}
+		auto byte = this->position / 8;
+		auto shift = (unsigned)(this->position % 8);
+		std::uint64_t x;
+		if (this->size - byte >= 8){
+			x = prefix_varint::load_little_endian(this->data + byte) >> shift;
+			if (shift + n > 64)
+				x |= (std::uint64_t)this->data[byte + 8] << (64 - shift);
+		}else{
+			x = 0;
+			for (auto i = this->size; i-- > byte;)
+				x = x << 8 | this->data[i];
+			x >>= shift;
+		}
+		if (n < 64)
+			x &= ((std::uint64_t)1 << n) - 1;
+		this->position += n;
+		dst = x;
+		return true;
+	}
+	size_t remaining() const{
+		return this->size * 8 - this->position;
+	}
+};
+
+template <typename Writer>
+void encode(const double *src, size_t n, Writer &writer){
+	if (!n)
+		return;
+	auto previous = to_bits(src[0]);
+	writer.write(previous, 64);
+	//No window yet.
+	unsigned leading = 64;
+	unsigned trailing = 64;
+	for (size_t i = 1; i < n; i++){
+		auto x = to_bits(src[i]);
+		auto delta = x ^ previous;
+		previous = x;
+		if (!delta){
+			writer.write(0, 1);
+			continue;
+		}
+		auto l = prefix_varint::count_leading_zeros(delta);
+		if (l > 31)
+			l = 31;
+		auto t = count_trailing_zeros(delta);
+		if (l >= leading && t >= trailing && leading + trailing < 64){
+			writer.write(1, 2);
+			writer.write(delta >> trailing, 64 - leading - trailing);
+			continue;
+		}
+		leading = l;
+		trailing = t;
+		auto meaningful = 64 - l - t;
+		writer.write(3, 2);
+		writer.write(l, 5);
+		writer.write(meaningful & 63, 6);
+		writer.write(delta >> t, meaningful);
+	}
+}
+
+}
+
+inline size_t encoded_size(const double *src, size_t n){
+	detail::BitCounter counter;
+	detail::encode(src, n, counter);
+	return (size_t)((counter.get_bits() + 7) / 8);
+}
+
+//Upper bound for encode(): 64 bits for the first value and 2 + 5 + 6 + 64 for
+//every other one.
+inline size_t max_encoded_size(size_t n){
+	if (!n)
+		return 0;
+	return (64 + (n - 1) * 77 + 7) / 8;
+}
+
+//dst must have room for encoded_size(src, n) bytes. Returns the number of
+//bytes written.
+inline size_t encode(const double *src, size_t n, std::uint8_t *dst){
+	detail::BitWriter writer(dst);
+	detail::encode(src, n, writer);
+	return writer.finish() - dst;
+}
+
+//Decodes n values from exactly size bytes. Returns false if the data is
+//truncated, malformed or followed by more than padding.
+inline bool decode(const std::uint8_t *data, size_t size, size_t n, double *dst){
+	if (!n)
+		return !size;
+	detail::BitReader reader(data, size);
+	std::uint64_t previous;
+	if (!reader.read(previous, 64))
+		return false;
+	dst[0] = detail::from_bits(previous);
+	unsigned leading = 0;
+	unsigned meaningful = 0;
+	for (size_t i = 1; i < n; i++){
+		std::uint64_t bit;
+		if (!reader.read(bit, 1))
+			return false;
+		if (bit){
+			if (!reader.read(bit, 1))
+				return false;
+			if (bit){
+				std::uint64_t l, m;
+				if (!reader.read(l, 5) || !reader.read(m, 6))
+					return false;
+				if (!m)
+					m = 64;
+				if (l + m > 64)
+					return false;
+				leading = (unsigned)l;
+				meaningful = (unsigned)m;
+			}else if (!meaningful)
+				return false;
+			std::uint64_t delta;
+			if (!reader.read(delta, meaningful))
+				return false;
+			previous ^= delta << (64 - leading - meaningful);
+		}
+		dst[i] = detail::from_bits(previous);
+	}
+	return reader.remaining() < 8;
+}
+
+}
@@ -31,4 +31,92 @@ std::optional<TypeMapping> process_first_message(const std::map<TypeHash, std::u
 	return ret;
 }
 
+Session::Session(const std::vector<std::pair<std::uint32_t, std::uint32_t>> &mapping, std::uint32_t wire_format): wire_format(wire_format){
+	map_t to_protocol, from_protocol;
+	to_protocol.reserve(mapping.size());
+	from_protocol.reserve(mapping.size());
+	for (auto &[native, protocol] : mapping){
+		to_protocol[native] = protocol;
+		from_protocol[protocol] = native;
+	}
+	this->to_protocol = std::make_shared<const map_t>(std::move(to_protocol));
+	this->from_protocol = std::make_shared<const map_t>(std::move(from_protocol));
+}
+
+SerializerStream::Options Session::get_serializer_options() const{
+	SerializerStream::Options ret;
+	ret.type_map = this->to_protocol.get();
+	ret.wire_format = this->wire_format;
+	return ret;
+}
+
+DeserializerStream::Options Session::get_deserializer_options() const{
+	DeserializerStream::Options ret;
+	ret.type_map = this->from_protocol.get();
+	ret.wire_format = this->wire_format;
+	return ret;
+}
+
+static void write_mapping(SerializerStream &ss, std::uint32_t wire_format, const std::vector<std::pair<std::uint32_t, std::uint32_t>> &mapping){
+	ss.serialize(wire_format);
+	ss.serialize((std::uint32_t)mapping.size());
+	for (auto &[native, protocol] : mapping){
+		ss.serialize(native);
+		ss.serialize(protocol);
+	}
+	ss.flush();
+}
+
+bool send_first_message(SerializerStream &ss, const Serializable &obj){
+	auto message = get_first_message(obj);
+	if (!message)
+		return false;
+	ss.serialize(wire_flags::all);
+	ss.serialize((std::uint32_t)message->size());
+	for (auto &[hash, id] : *message){
+		ss.serialize(id);
+		ss.serialize_array(hash.digest);
+	}
+	ss.flush();
+	return true;
+}
+
+std::optional<Session> accept_session(DeserializerStream &ds, SerializerStream &ss, const Serializable &obj){
+	std::map<TypeHash, std::uint32_t> message;
+	std::uint32_t wire_format, size;
+	ds.deserialize(wire_format);
+	wire_format &= wire_flags::all;
+	ds.deserialize(size);
+	while (size--){
+		std::uint32_t id;
+		TypeHash hash;
+		ds.deserialize(id);
+		ds.deserialize_array(hash.digest);
+		message[hash] = id;
+	}
+	auto mapping = process_first_message(message, obj);
+	if (!mapping || mapping->for_party_a.empty()){
+		write_mapping(ss, 0, {});
+		return {};
+	}
+	write_mapping(ss, wire_format, mapping->for_party_a);
+	return Session(mapping->for_party_b, wire_format);
+}
+
+std::optional<Session> connect_session(DeserializerStream &ds){
+	std::vector<std::pair<std::uint32_t, std::uint32_t>> mapping;
+	std::uint32_t wire_format, size;
+	ds.deserialize(wire_format);
+	ds.deserialize(size);
+	while (size--){
+		std::uint32_t native, protocol;
+		ds.deserialize(native);
+		ds.deserialize(protocol);
+		mapping.emplace_back(native, protocol);
+	}
+	if (mapping.empty())
+		return {};
+	return Session(mapping, wire_format);
+}
+
 }
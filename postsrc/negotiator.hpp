@@ -1,7 +1,11 @@
 #pragma once
 
 #include "Serializable.hpp"
+#include "SerializerStream.hpp"
+#include "DeserializerStream.hpp"
 #include <map>
+#include <memory>
+#include <unordered_map>
 #include <cstdint>
 #include <optional>
 #include <vector>
@@ -28,4 +32,52 @@ public:
 //ambiguities.
 std::optional<TypeMapping> process_first_message(const std::map<TypeHash, std::uint32_t> &, const Serializable &);
 
+//One end of a connection whose type systems have been negotiated. Messages
+//sent through the session carry protocol type IDs, which only mean something
+//to the two ends, instead of type hashes.
+class Session{
+	typedef std::unordered_map<std::uint32_t, std::uint32_t> map_t;
+	//The maps are held by pointer so that they don't move with the session.
+	//native type ID -> protocol type ID
+	std::shared_ptr<const map_t> to_protocol;
+	//protocol type ID -> native type ID
+	std::shared_ptr<const map_t> from_protocol;
+	//wire_flags understood by both ends.
+	std::uint32_t wire_format;
+public:
+	//Takes (native type ID, protocol type ID) pairs, such as either half of a
+	//TypeMapping.
+	Session(const std::vector<std::pair<std::uint32_t, std::uint32_t>> &, std::uint32_t wire_format = 0);
+	Session(const Session &) = delete;
+	Session(Session &&) = default;
+	Session &operator=(Session &&) = default;
+	//The options refer to the session's maps, so the session, or the one it's
+	//moved to, must outlive them.
+	SerializerStream::Options get_serializer_options() const;
+	DeserializerStream::Options get_deserializer_options() const;
+	std::uint32_t get_wire_format() const{
+		return this->wire_format;
+	}
+};
+
+//The handshake, done once per connection. Party A sends its types and the
+//wire_flags it understands with send_first_message(). Party B reads them with
+//accept_session(), which replies with the flags both understand and party A's
+//half of the mapping, and party A reads the reply with connect_session(). The
+//handshake itself always uses the default wire format.
+
+//Called by party A
+//Returns false if the type system cannot be negotiated, as it contains
+//ambiguities.
+bool send_first_message(SerializerStream &, const Serializable &);
+
+//Called by party B
+//Party A is sent an empty mapping if the type system cannot be negotiated or
+//the two ends have no types in common.
+std::optional<Session> accept_session(DeserializerStream &, SerializerStream &, const Serializable &);
+
+//Called by party A
+//If the optional is null, party B sent an empty mapping.
+std::optional<Session> connect_session(DeserializerStream &);
+
 }
@@ -14,6 +14,7 @@
 #include <unordered_set>
 #include <map>
 #include <unordered_map>
+#include "buffer_view.hpp"
 
 class SerializerStream;
 class Serializable;
@@ -64,6 +65,9 @@ public:
 	std::uint32_t get_typeid(){
 		return this->type_id;
 	}
+	bool get_is_serializable() const{
+		return this->is_serializable;
+	}
 	const void *get_address() const{
 		return this->address;
 	}
@@ -152,6 +156,20 @@ ObjectNode get_object_node(const std::shared_ptr<T> &n, std::uint32_t type_id){
 
 typedef std::uint64_t wire_size_t;
 
+//Fixed-width values are little endian on the wire, so on little endian hosts
+//arrays of them can be copied as they are.
+#if defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define SERIALIZATION_BIG_ENDIAN
+#endif
+
+template <typename T>
+T byte_swap(T x){
+	T ret = 0;
+	for (size_t i = 0; i < sizeof(T); i++, x >>= 8)
+		ret = ret << 8 | (x & 0xFF);
+	return ret;
+}
+
 template <typename T>
 struct is_basic_type{
 	static const bool value = std::is_fundamental<T>::value || std::is_pointer<T>::value;
@@ -191,6 +209,41 @@ struct is_maplike{
 template <typename T1, typename T2> struct is_maplike<std::map<T1, T2>>{ static const bool value = true; };
 template <typename T1, typename T2> struct is_maplike<std::unordered_map<T1, T2>>{ static const bool value = true; };
 
+template <typename Container>
+struct is_ordered_container{
+	static const bool value = false;
+};
+
+template <typename T> struct is_ordered_container<std::set<T>>{ static const bool value = true; };
+template <typename T1, typename T2> struct is_ordered_container<std::map<T1, T2>>{ static const bool value = true; };
+
+template <typename T>
+struct is_delta_key{
+	static const bool value = std::is_integral<T>::value && !std::is_same<T, bool>::value;
+};
+
+//With wire_flags::sorted_key_deltas, the first key of an ordered container is
+//written as is and every other one as this gap from the key before it. a < b.
+template <typename T>
+typename std::make_unsigned<T>::type ordered_key_gap(T a, T b){
+	typedef typename std::make_unsigned<T>::type U;
+	return (U)((U)b - (U)a - 1);
+}
+
+//The inverse of ordered_key_gap(). Returns false if the key would be past the
+//largest value of T.
+template <typename T>
+bool ordered_key_after(T a, typename std::make_unsigned<T>::type gap, T &dst){
+	typedef typename std::make_unsigned<T>::type U;
+	//Maps T to U in the same order.
+	const U bias = std::is_signed<T>::value ? (U)((U)1 << (sizeof(T) * 8 - 1)) : 0;
+	auto x = (U)((U)a ^ bias);
+	if (gap >= (U)(std::numeric_limits<U>::max() - x))
+		return false;
+	dst = (T)(U)((U)(x + gap + 1) ^ bias);
+	return true;
+}
+
 template <typename T>
 struct is_container{
 	static const bool value = is_sequence_container<T>::value || is_maplike<T>::value;
@@ -206,6 +259,11 @@ struct is_string<std::basic_string<T>>{
 	static const bool value = true;
 };
 
+template <typename T>
+struct is_string<buffer_view<T>>{
+	static const bool value = true;
+};
+
 template <typename T>
 struct is_simply_constructible{
 	static const bool value =
@@ -236,19 +294,6 @@ struct static_get_type_id{
 	static const std::uint32_t value = 0;
 };
 
-template <typename T>
-class conditional_deleter{
-	bool enabled = true;
-public:
-	void disable(){
-		this->enabled = false;
-	}
-	void operator()(T *p){
-		if (this->enabled)
-			delete p;
-	}
-};
-
 template <typename T>
 struct get_enum_type_id{};
 
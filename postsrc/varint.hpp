@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#if defined __BMI__ || defined __BMI2__ || defined __LZCNT__
+#include <immintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//Optional features of the wire format. The sender and the receiver must use
+//the same ones (type_negotiation::Session picks them during the handshake),
+//since messages don't say which ones they use. SerializerStream::Options and
+//DeserializerStream::Options take a combination of them in wire_format.
+namespace wire_flags{
+//Unsigned integers, and so signed integers, sizes and object IDs, are written
+//as prefix-length varints (see prefix_varint below) rather than as 7-bit
+//groups with continuation bits.
+const std::uint32_t prefix_varints = 1 << 0;
+//Vectors of 16, 32 and 64 bit integers, and strings of 16 and 32 bit
+//characters, are written with block_codec rather than one varint per element.
+//Their sizes are still varints.
+const std::uint32_t block_integers = 1 << 1;
+//The integer keys of std::sets and std::maps, which are in order, are written
+//as the gaps between them (see ordered_key_gap()).
+const std::uint32_t sorted_key_deltas = 1 << 2;
+//Every flag this implementation understands.
+const std::uint32_t all = prefix_varints | block_integers | sorted_key_deltas;
+}
+
+//A prefix-length varint is 1 to 9 bytes long. The number of trailing zeros of
+//the first byte, plus one, is the length, so the decoder knows it before it
+//reads the rest. In the 1 to 8 byte forms, the value is stored shifted left
+//past that marker, in little endian, 7 bits per byte. The 9 byte form is a
+//zero byte followed by the value as 8 little endian bytes.
+namespace prefix_varint{
+
+const unsigned max_length = 9;
+
+inline unsigned count_trailing_zeros(std::uint32_t x){
+#if defined __BMI__
+	return _tzcnt_u32(x);
+#elif defined __GNUC__
+	return __builtin_ctz(x);
+#elif defined _MSC_VER
+	unsigned long ret;
+	_BitScanForward(&ret, x);
+	return ret;
+#else
+	unsigned ret = 0;
+	for (; !(x & 1); x >>= 1)
+		ret++;
+	return ret;
+#endif
+}
+
+//x must not be zero.
+inline unsigned count_leading_zeros(std::uint64_t x){
+#if defined __LZCNT__
+	return (unsigned)_lzcnt_u64(x);
+#elif defined __GNUC__
+	return __builtin_clzll(x);
+#elif defined _MSC_VER && defined _M_X64
+	unsigned long ret;
+	_BitScanReverse64(&ret, x);
+	return 63 - ret;
+#else
+	unsigned ret = 0;
+	for (; !(x >> 63); x <<= 1)
+		ret++;
+	return ret;
+#endif
+}
+
+inline std::uint64_t load_little_endian(const std::uint8_t *p){
+	std::uint64_t ret;
+	memcpy(&ret, p, sizeof(ret));
+#if defined __BYTE_ORDER__ && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	ret = __builtin_bswap64(ret);
+#endif
+	return ret;
+}
+
+inline unsigned encoded_length(std::uint64_t n){
+	auto bits = 64 - count_leading_zeros(n | 1);
+	return bits > 56 ? max_length : (bits + 6) / 7;
+}
+
+inline unsigned length_from_first_byte(std::uint8_t first){
+	return first ? count_trailing_zeros(first) + 1 : max_length;
+}
+
+//dst must have room for max_length bytes. Returns the length.
+inline unsigned encode(std::uint8_t *dst, std::uint64_t n){
+	auto length = encoded_length(n);
+	std::uint64_t x;
+	if (length == max_length){
+		*dst++ = 0;
+		x = n;
+	}else
+		x = n << length | (std::uint64_t)1 << (length - 1);
+	for (unsigned i = 0; i < 8; i++, x >>= 8)
+		dst[i] = (std::uint8_t)x;
+	return length;
+}
+
+//Decodes with one 8 byte load and a mask and a shift. There must be at least
+//max_length readable bytes at p, whatever the length of the number.
+inline std::uint64_t decode_fast(const std::uint8_t *p, unsigned &length){
+	auto x = load_little_endian(p);
+	if (!(std::uint8_t)x){
+		length = max_length;
+		return load_little_endian(p + 1);
+	}
+	length = count_trailing_zeros((std::uint32_t)x) + 1;
+#if defined __BMI2__ && (defined __x86_64__ || defined _M_X64)
+	return _bzhi_u64(x, length * 8) >> length;
+#else
+	return x << (64 - length * 8) >> (64 - length * 7);
+#endif
+}
+
+//Decodes from exactly length bytes.
+inline std::uint64_t decode(const std::uint8_t *p, unsigned length){
+	if (length == max_length)
+		return load_little_endian(p + 1);
+	std::uint64_t x = 0;
+	for (unsigned i = length; i--;)
+		x = x << 8 | p[i];
+	return x >> length;
+}
+
+}
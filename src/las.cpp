@@ -35,9 +35,10 @@ DEFINE_get_X_function_name(constructor)
 DEFINE_get_X_function_name(rollbacker)
 DEFINE_get_X_function_name(is_serializable)
 DEFINE_get_X_function_name(dynamic_cast)
-DEFINE_get_X_function_name(allocate_pointer)
 DEFINE_get_X_function_name(categorize_cast)
 DEFINE_get_X_function_name(check_enum)
+DEFINE_get_X_function_name(object_layout)
+DEFINE_get_X_function_name(destructor)
 
 std::string IntegerType::get_source_name() const{
 	return "std::"s + (!this->signedness ? "u" : "") + "int" + std::to_string(8 << this->size) + "_t";
@@ -193,7 +194,7 @@ void ArrayType::generate_pointer_enumerator(generate_pointer_enumerator_callback
 void PointerType::generate_pointer_enumerator(generate_pointer_enumerator_callback_t &callback, const std::string &this_name) const{
 	std::stringstream stream;
 	if (!this->inner->is_serializable())
-		stream << "::get_object_node(" << this_name << ", static_get_type_id<" << this->inner << ">::value)";
+		stream << "::get_object_node(" << this_name << ", static_get_type_id<" << this->inner->get_source_name() << ">::value)";
 	else
 		stream << "::get_object_node((Serializable *)" << this_name << ")";
 	callback(stream.str(), CallMode::TransformAndAdd);
@@ -202,7 +203,7 @@ void PointerType::generate_pointer_enumerator(generate_pointer_enumerator_callba
 void StdSmartPtrType::generate_pointer_enumerator(generate_pointer_enumerator_callback_t &callback, const std::string &this_name) const{
 	std::stringstream stream;
 	if (!this->inner->is_serializable())
-		stream << "::get_object_node((" << this_name << ").get(), static_get_type_id<" << this->inner << ">::value)";
+		stream << "::get_object_node((" << this_name << ").get(), static_get_type_id<" << this->inner->get_source_name() << ">::value)";
 	else
 		stream << "::get_object_node((Serializable *)(" << this_name << ").get())";
 	callback(stream.str(), CallMode::TransformAndAdd);
@@ -303,10 +304,11 @@ public:
 	virtual ~{name}();
 	virtual void get_object_node(std::vector<ObjectNode> &) const override;
 	virtual void serialize(SerializerStream &) const override;
+	virtual std::uint64_t serialized_size(const SerializerStream &) const override;
 	virtual std::uint32_t get_type_id() const override;
 	virtual TypeHash get_type_hash() const override;
-	virtual std::shared_ptr<SerializableMetadata> get_metadata() const override;
-	static std::shared_ptr<SerializableMetadata> static_get_metadata();
+	virtual std::shared_ptr<const SerializableMetadata> get_metadata() const override;
+	static std::shared_ptr<const SerializableMetadata> static_get_metadata();
 	static const char *static_get_class_name(){{
 		return "{name}";
 	}}
@@ -396,6 +398,10 @@ void UserClass::generate_serialize(std::ostream &stream) const{
 		auto casted = std::dynamic_pointer_cast<ClassMember>(e);
 		if (!casted)
 			continue;
+		if (casted->get_encoding() == MemberEncoding::Gorilla){
+			stream << "ss.serialize_gorilla(this->" << casted->get_name() << ");\n";
+			continue;
+		}
 		stream << "ss.serialize(";
 		auto t = casted->get_type();
 		auto ut = t->get_underlying_type();
@@ -405,6 +411,29 @@ void UserClass::generate_serialize(std::ostream &stream) const{
 	}
 }
 
+void UserClass::generate_serialized_size(std::ostream &stream) const{
+	stream << "std::uint64_t ret = 0;\n";
+	for (auto &b : this->base_classes)
+		stream << "ret += " << b.Class->get_name() << "::serialized_size(ss);\n";
+	
+	for (auto &e : this->elements){
+		auto casted = std::dynamic_pointer_cast<ClassMember>(e);
+		if (!casted)
+			continue;
+		if (casted->get_encoding() == MemberEncoding::Gorilla){
+			stream << "ret += ss.serialized_size_gorilla(this->" << casted->get_name() << ");\n";
+			continue;
+		}
+		stream << "ret += ss.serialized_size(";
+		auto t = casted->get_type();
+		auto ut = t->get_underlying_type();
+		if (t.get() != ut.get())
+			stream << "(" << ut->get_source_name() << ")";
+		stream << "(this->" << casted->get_name() << "));\n";
+	}
+	stream << "return ret;\n";
+}
+
 void UserClass::generate_get_type_hash(std::ostream &stream) const{
 	stream << "return " << this->root->get_name() << "_id_hashes[" << (this->get_type_id() - 1) << "].second;";
 }
@@ -437,13 +466,45 @@ void UserClass::generate_deserializer(std::ostream &stream) const{
 		}
 		stream << casted->get_name() << "(";
 		auto type = casted->get_type();
-		if (std::dynamic_pointer_cast<UserClass>(type))
+		if (casted->get_encoding() == MemberEncoding::Gorilla)
+			stream << "ds.deserialize_gorilla()";
+		else if (std::dynamic_pointer_cast<UserClass>(type))
 			stream << "ds";
 		else
 			stream << "proxy_constructor<" << type->get_source_name() << ">(ds)";
 		stream << ")\n";
 	}
-	stream << "{}";
+	//Roots record the offsets the cast categorizer uses for their whole tree.
+	std::stringstream body;
+	if (this->is_inheritance_root())
+		for (auto &[type, value] : this->get_ancestors())
+			if (!value.second)
+				body << "learned_base_offset<" << this->get_source_name() << ", " << value.first->get_source_name() << ">::learn(this);\n";
+	auto s = body.str();
+	if (s.empty())
+		stream << "{}";
+	else
+		stream << "{\n" << s << "}";
+}
+
+std::map<std::uint32_t, std::pair<UserClass *, bool>> UserClass::get_ancestors() const{
+	std::map<std::uint32_t, std::pair<UserClass *, bool>> ret;
+	std::vector<std::pair<const UserClass *, bool>> pending{ { this, false } };
+	while (pending.size()){
+		auto [uc, Virtual] = pending.back();
+		pending.pop_back();
+		for (auto &base : uc->get_base_classes()){
+			std::pair<UserClass *, bool> value(base.Class.get(), Virtual || base.Virtual);
+			auto [it, inserted] = ret.emplace(base.Class->get_type_id(), value);
+			if (!inserted){
+				if (it->second.second || !value.second)
+					continue;
+				it->second.second = true;
+			}
+			pending.emplace_back(value);
+		}
+	}
+	return ret;
 }
 
 void UserClass::generate_deserializer(std::ostream &stream, const char *deserializer_name, const char *pointer_name) const{
@@ -494,6 +555,10 @@ void {namespace}{name}::serialize(SerializerStream &ss) const{{
 {ser}
 }}
 
+std::uint64_t {namespace}{name}::serialized_size(const SerializerStream &ss) const{{
+{size}
+}}
+
 std::uint32_t {namespace}{name}::get_type_id() const{{
 {gti}
 }}
@@ -502,11 +567,11 @@ TypeHash {namespace}{name}::get_type_hash() const{{
 {gth}
 }}
 
-std::shared_ptr<SerializableMetadata> {namespace}{name}::get_metadata() const{{
+std::shared_ptr<const SerializableMetadata> {namespace}{name}::get_metadata() const{{
 return this->static_get_metadata();
 }}
 
-std::shared_ptr<SerializableMetadata> {namespace}{name}::static_get_metadata(){{
+std::shared_ptr<const SerializableMetadata> {namespace}{name}::static_get_metadata(){{
 {gmd}
 }}
 )file";
@@ -518,6 +583,7 @@ std::shared_ptr<SerializableMetadata> {namespace}{name}::static_get_metadata(){{
 		<< "dtor" << this->generate_destructor()
 		<< "gon" << this->generate_get_object_node2()
 		<< "ser" << this->generate_serialize()
+		<< "size" << this->generate_serialized_size()
 		<< "gti" << ("return " + utoa(this->get_type_id()) + ";")
 		<< "gth" << this->generate_get_type_hash()
 		<< "gmd" << this->generate_get_metadata());
@@ -568,7 +634,12 @@ std::string UserClass::base_get_type_string() const{
 			stream << ',';
 		else
 			first = false;
-		stream << '(' << (int)casted->get_accessibility() << ',' << casted->get_type()->get_underlying_type()->get_serializer_name() << ',' << casted->get_name() << ')';
+		stream << '(' << (int)casted->get_accessibility() << ',' << casted->get_type()->get_underlying_type()->get_serializer_name() << ',' << casted->get_name();
+		//The encoding changes the wire format, so it must change the type
+		//hash too.
+		if (casted->get_encoding() == MemberEncoding::Gorilla)
+			stream << ",gorilla";
+		stream << ')';
 	}
 	stream << ")}";
 	return stream.str();
@@ -998,7 +1069,7 @@ void CppFile::generate_header(){
 }
 
 std::string generate_get_metadata_signature(){
-	return "std::shared_ptr<SerializableMetadata> " + get_get_metadata_function_name() + "()";
+	return "std::shared_ptr<const SerializableMetadata> " + get_get_metadata_function_name() + "()";
 }
 
 std::string CppFile::generate_source1(){
@@ -1058,10 +1129,10 @@ void CppFile::generate_source(){
 		&CppFile::generate_allocator,
 		&CppFile::generate_constructor,
 		&CppFile::generate_rollbacker,
+		&CppFile::generate_object_layout,
+		&CppFile::generate_destructor,
 		&CppFile::generate_is_serializable,
 		&CppFile::generate_dynamic_cast,
-		&CppFile::generate_generic_pointer_classes_and_implementations,
-		&CppFile::generate_pointer_allocator,
 		&CppFile::generate_cast_categorizer,
 		&CppFile::generate_enum_checker,
 		&CppFile::generate_enum_stringifiers,
@@ -1178,6 +1249,73 @@ void {name}(std::uint32_t type, void *s){{
 	;
 }
 
+std::string CppFile::generate_alignments(){
+	std::stringstream ret;
+	for (auto &kv : this->type_map){
+		if (kv.second->is_abstract()){
+			ret << "0, ";
+			continue;
+		}
+		ret << "alignof(" << kv.second->get_source_name() << "), ";
+	}
+
+	return ret.str();
+}
+
+std::string CppFile::generate_object_layout(){
+	static const char * const format =
+R"file(
+void {name}(std::uint32_t type, size_t &size, size_t &alignment){{
+	static const size_t sizes[] = {{
+		{sizes}
+	}};
+	static const size_t alignments[] = {{
+		{alignments}
+	}};
+	type--;
+	size = sizes[type];
+	alignment = alignments[type];
+}}
+)file";
+	return variable_formatter(format)
+		<< "name" << get_object_layout_function_name()
+		<< "sizes" << this->generate_sizes()
+		<< "alignments" << this->generate_alignments()
+	;
+}
+
+std::string CppFile::generate_destructors(){
+	std::stringstream stream;
+	for (auto &kv : this->type_map){
+		if (kv.second->is_abstract()){
+			stream << "nullptr,\n";
+			continue;
+		}
+		stream << "[](void *s){ std::destroy_at((" << kv.second->get_source_name() << " *)s); },\n";
+	}
+	return stream.str();
+}
+
+std::string CppFile::generate_destructor(){
+	static const char * const format =
+R"file(
+void {name}(std::uint32_t type, void *s){{
+	typedef void (*destructor_f)(void *);
+	static const destructor_f destructors[] = {{
+		{destructors}
+	}};
+	type--;
+	if (!destructors[type])
+		return;
+	return destructors[type](s);
+}}
+)file";
+	return variable_formatter(format)
+		<< "name" << get_destructor_function_name()
+		<< "destructors" << this->generate_destructors()
+	;
+}
+
 std::string CppFile::generate_is_serializable(){
 	std::vector<std::uint32_t> flags;
 	int bit = 0;
@@ -1246,291 +1384,134 @@ Serializable *{name}(void *src, std::uint32_t type){{
 	;
 }
 
-std::string CppFile::generate_generic_pointer_classes(){
-	static const char * const format =
-R"file(
-class RawPointer{name} : public GenericPointer{{
-	std::unique_ptr<{fqn} *> real_pointer;
-public:
-	RawPointer{name}(void *p){{
-		this->real_pointer.reset(new {fqn} *(({fqn} *)p));
-		this->pointer = this->real_pointer.get();
-	}}
-	~RawPointer{name}() = default;
-	void release() override{{}}
-	std::unique_ptr<GenericPointer> cast(std::uint32_t type) override;
-}};
-
-class SharedPtr{name} : public GenericPointer{{
-	std::unique_ptr<std::shared_ptr<{fqn}>> real_pointer;
-public:
-	SharedPtr{name}(void *p){{
-		this->real_pointer.reset(new std::shared_ptr<{fqn}>(({fqn} *)p, conditional_deleter<{fqn}>()));
-		this->pointer = this->real_pointer.get();
-	}}
-	template <typename T>
-	SharedPtr{name}(const std::shared_ptr<T> &p){{
-		this->real_pointer.reset(new std::shared_ptr<{fqn}>(std::static_pointer_cast<{fqn}>(p)));
-		this->pointer = this->real_pointer.get();
-	}}
-	~SharedPtr{name}() = default;
-	void release() override{{
-		std::get_deleter<conditional_deleter<{fqn}>> (*this->real_pointer)->disable();
-	}}
-	std::unique_ptr<GenericPointer> cast(std::uint32_t type) override;
-}};
-
-class UniquePtr{name} : public GenericPointer{{
-    std::unique_ptr<std::unique_ptr<{fqn}>> real_pointer;
-public:
-    UniquePtr{name}(void *p){{
-        this->real_pointer.reset(new std::unique_ptr<{fqn}>(({fqn} *)p));
-        this->pointer = this->real_pointer.get();
-	}}
-    ~UniquePtr{name}() = default;
-    void release() override{{
-        this->real_pointer->release();
-	}}
-    std::unique_ptr<GenericPointer> cast(std::uint32_t type) override;
-}};
-)file";
-
-	std::string ret;
-	for (auto &kv1 : this->type_map){
-		if (!kv1.second->is_serializable())
-			continue;
-		auto uc1 = static_cast<UserClass *>(kv1.second);
-
-		ret += variable_formatter(format)
-			<< "name" << uc1->get_name()
-			<< "fqn" << uc1->fully_qualified_name()
-		;
-	}
-	return ret;
-}
-
-std::string CppFile::generate_cast_cases(UserClass &uc1, const char *format){
-	std::string ret;
-	for (auto &kv2 : this->type_map){
-		if (!kv2.second->is_serializable())
-			continue;
-		auto uc2 = static_cast<UserClass *>(kv2.second);
-		if (!uc1.is_subclass_of(*uc2))
-			continue;
-		ret += variable_formatter(format)
-			<< "name" << uc2->get_name()
-			<< "id" << uc2->get_type_id();
-	}
-	return ret;
-}
-
-std::string CppFile::generate_raw_pointer_cast_cases(UserClass &uc1){
-	static const char * const format =
-R"file(
-		case {id}:
-			return std::unique_ptr<GenericPointer>(new RawPointer{name}(*this->real_pointer));
-)file";
-	return this->generate_cast_cases(uc1, format);
-}
-
-std::string CppFile::generate_shared_ptr_cast_cases(UserClass &uc1){
-	static const char * const format =
-R"file(
-		case {id}:
-			return std::unique_ptr<GenericPointer>(new SharedPtr{name}(*this->real_pointer));
-)file";
-	return this->generate_cast_cases(uc1, format);
-}
-
-std::string CppFile::generate_unique_ptr_cast_cases(UserClass &uc1){
-	static const char * const format =
-R"file(
-		case {id}:
-			throw std::runtime_error("Multiple unique pointers to single object detected.");
-)file";
-	return this->generate_cast_cases(uc1, format);
-}
-
-std::string CppFile::generate_generic_pointer_class_implementations(){
-	static const char * const format =
-R"file(
-std::unique_ptr<GenericPointer> RawPointer{name}::cast(std::uint32_t type){{
-	switch (type){{
-{switch_cases_RawPointer}
-		default:
-			return {{}};
-	}}
-}}
-
-std::unique_ptr<GenericPointer> SharedPtr{name}::cast(std::uint32_t type){{
-	switch (type){{
-{switch_cases_SharedPtr}
-		default:
-			return {{}};
-	}}
-}}
-
-std::unique_ptr<GenericPointer> UniquePtr{name}::cast(std::uint32_t type){{
-	switch (type){{
-{switch_cases_UniquePtr}
-		default:
-			return {{}};
-	}}
-}}
-)file";
-
-	std::string ret;
-	for (auto &kv1 : this->type_map){
-		if (!kv1.second->is_serializable())
+//Encodes the class hierarchy in tables of size linear in the number of types.
+//Classes that inherit from a single base, non-virtually, form a forest, which
+//is numbered in pre-order so that each class's descendants in its tree are an
+//interval. Every class inherits from the classes on the path to the root of
+//its tree, plus, if the root itself inherits from anything, the root's
+//ancestors, which are listed once per root. Each of those is listed along with
+//where the root's constructor records its offset (see learned_base_offset),
+//unless the root reaches it through a virtual base.
+void CppFile::generate_class_hierarchy(unsigned max_type, std::string &hierarchy, std::string &ancestors, std::string &offsets){
+	struct Node{
+		UserClass *Class = nullptr;
+		std::vector<std::uint32_t> children;
+		std::uint32_t first = 0;
+		std::uint32_t last = 0;
+		std::uint32_t root = 0;
+	};
+	std::vector<Node> nodes(max_type + 1);
+	std::vector<std::uint32_t> roots;
+	for (unsigned type = 1; type <= max_type; type++){
+		auto t = this->type_map[type];
+		if (!t || !t->is_serializable())
 			continue;
-		auto uc1 = static_cast<UserClass *>(kv1.second);
-		auto name = uc1->get_name();
-
-		ret += variable_formatter(format)
-			<< "name" << name
-			<< "switch_cases_RawPointer" << this->generate_raw_pointer_cast_cases(*uc1)
-			<< "switch_cases_SharedPtr" << this->generate_shared_ptr_cast_cases(*uc1)
-			<< "switch_cases_UniquePtr" << this->generate_unique_ptr_cast_cases(*uc1)
-		;
+		auto uc = static_cast<UserClass *>(t);
+		nodes[type].Class = uc;
+		auto &bases = uc->get_base_classes();
+		if (!uc->is_inheritance_root())
+			nodes[bases.front().Class->get_type_id()].children.push_back(type);
+		else
+			roots.push_back(type);
 	}
 
-	return ret;
-}
-
-std::string CppFile::generate_generic_pointer_classes_and_implementations(){
-	return
-		"namespace {\n" +
-		this->generate_generic_pointer_classes() + "\n" +
-		this->generate_generic_pointer_class_implementations() + "\n"
-		"}\n";
-}
-
-std::string CppFile::generate_allocator_cases(const char *format){
-	std::string ret;
-	for (auto &kv : this->type_map){
-		if (!kv.second->is_serializable())
-			continue;
-		auto uc = static_cast<UserClass *>(kv.second);
-		auto name = uc->get_name();
-		ret += variable_formatter(format) << "name" << uc->get_name() << "id" << uc->get_type_id();
-	}
-	return ret;
-}
-
-std::string CppFile::generate_raw_pointer_allocator_cases(){
-	static const char * const format =
-R"file(
-				case {id}:
-					return std::unique_ptr<GenericPointer>(new RawPointer{name}(p));
-)file";
-	return this->generate_allocator_cases(format);
-}
-
-std::string CppFile::generate_shared_pointer_allocator_cases(){
-	static const char * const format =
-R"file(
-				case {id}:
-					return std::unique_ptr<GenericPointer>(new SharedPtr{name}(p));
-)file";
-	return this->generate_allocator_cases(format);
-}
-
-std::string CppFile::generate_unique_ptr_allocator_cases(){
-	static const char * const format =
-R"file(
-				case {id}:
-					return std::unique_ptr<GenericPointer>(new UniquePtr{name}(p));
-)file";
-	return this->generate_allocator_cases(format);
-}
-
-std::string CppFile::generate_pointer_allocator(){
-	static const char * const format =
-R"file(
-std::unique_ptr<GenericPointer> {name}(std::uint32_t type, PointerType pointer_type, void *p){{
-	switch (pointer_type){{
-		case PointerType::RawPointer:
-			switch (type){{
-{switch_cases_RawPointer}
-				default:
-					return std::unique_ptr<GenericPointer>();
-			}}
-			break;
-		case PointerType::SharedPtr:
-			switch (type){{
-{switch_cases_SharedPtr}
-				default:
-					return std::unique_ptr<GenericPointer>();
-			}}
-			break;
-		case PointerType::UniquePtr:
-			switch (type){{
-{switch_cases_UniquePtr}
-				default:
-					return std::unique_ptr<GenericPointer>();
-			}}
-			break;
-		default:
-			throw std::runtime_error("Internal error. Unknown pointer type.");
-	}}
-}}
-)file";
-
-	return variable_formatter(format)
-		<< "name" << get_allocate_pointer_function_name()
-		<< "switch_cases_RawPointer" << this->generate_raw_pointer_allocator_cases()
-		<< "switch_cases_SharedPtr" << this->generate_shared_pointer_allocator_cases()
-		<< "switch_cases_UniquePtr" << this->generate_unique_ptr_allocator_cases()
-	;
-}
-
-std::string CppFile::generate_cast_categories(unsigned max_type){
-	static const char * const trivial = "\t\tCastCategory::Trivial,\n";
-	static const char * const invalid = "\t\tCastCategory::Invalid,\n";
-	static const char * const complex = "\t\tCastCategory::Complex,\n";
-	std::string ret;
-	for (unsigned src = 1; src <= max_type; src++){
-		for (unsigned dst = 1; dst <= max_type; dst++){
-			if (src == dst){
-				ret += trivial;
-				continue;
-			}
-			auto src_t = this->type_map[src];
-			auto dst_t = this->type_map[dst];
-			if (!src_t->is_serializable() || !dst_t->is_serializable()){
-				ret += invalid;
+	std::uint32_t next = 1;
+	std::vector<std::pair<std::uint32_t, size_t>> stack;
+	for (auto root : roots){
+		stack.emplace_back(root, 0);
+		nodes[root].first = next++;
+		nodes[root].root = root;
+		while (stack.size()){
+			auto &[type, child] = stack.back();
+			auto &node = nodes[type];
+			if (child == node.children.size()){
+				node.last = next;
+				stack.pop_back();
 				continue;
 			}
-			auto src_class = static_cast<UserClass *>(src_t);
-			auto dst_class = static_cast<UserClass *>(dst_t);
-			if (!src_class->is_subclass_of(*dst_class)){
-				ret += invalid;
-				continue;
-			}
-			if (src_class->is_trivial_class()){
-				ret += trivial;
-				continue;
-			}
-			ret += complex;
+			auto next_type = node.children[child++];
+			nodes[next_type].first = next++;
+			nodes[next_type].root = root;
+			stack.emplace_back(next_type, 0);
 		}
 	}
-	return ret;
+
+	//(begin, end) in the ancestor list, for each root.
+	std::map<std::uint32_t, std::pair<size_t, size_t>> root_ancestors;
+	size_t ancestor_count = 0;
+	for (auto root : roots){
+		auto map = nodes[root].Class->get_ancestors();
+		root_ancestors[root] = { ancestor_count, ancestor_count + map.size() };
+		ancestor_count += map.size();
+		auto root_name = nodes[root].Class->get_source_name();
+		for (auto &[type, value] : map){
+			ancestors += "\t\t" + std::to_string(type) + ",\n";
+			if (value.second)
+				offsets += "\t\tnullptr,\n";
+			else
+				offsets += "\t\t&learned_base_offset<" + root_name + ", " + value.first->get_source_name() + ">::value,\n";
+		}
+	}
+	//Zero-length arrays aren't allowed.
+	ancestors += "\t\t0,\n";
+	offsets += "\t\tnullptr,\n";
+
+	for (unsigned type = 1; type <= max_type; type++){
+		auto &node = nodes[type];
+		std::pair<size_t, size_t> range(0, 0);
+		if (node.Class)
+			range = root_ancestors[node.root];
+		hierarchy +=
+			"\t\t{ " + std::to_string(node.first) +
+			", " + std::to_string(node.last) +
+			", " + std::to_string(range.first) +
+			", " + std::to_string(range.second) + " },\n";
+	}
 }
 
 std::string CppFile::generate_cast_categorizer(){
 	static const char * const format =
 R"file(
-CastCategory {name}(std::uint32_t src_type, std::uint32_t dst_type){{
+CastCategory {name}(std::uint32_t src_type, std::uint32_t dst_type, std::ptrdiff_t &offset){{
 	if (src_type < 1 || dst_type < 1 || src_type > {max_type} || dst_type > {max_type})
 		return CastCategory::Invalid;
 	if (src_type == dst_type)
 		return CastCategory::Trivial;
-	static const CastCategory categories[] = {{
-{categories}
+	//For each type: its pre-order number in the single inheritance forest
+	//(0 if it's not a class), one past the number of its last descendant, and
+	//the range in ancestors of the classes the root of its tree inherits from.
+	static const std::uint32_t hierarchy[][4] = {{
+{hierarchy}
+	}};
+	static const std::uint32_t ancestors[] = {{
+{ancestors}
+	}};
+	static const std::atomic<std::ptrdiff_t> * const offsets[] = {{
+{offsets}
 	}};
-	src_type--;
-	dst_type--;
-	return categories[dst_type + src_type * {max_type}];
+	auto &src = hierarchy[src_type - 1];
+	auto &dst = hierarchy[dst_type - 1];
+	if (!src[0] || !dst[0])
+		return CastCategory::Invalid;
+	//Bases on the path to the root of the tree are at the same address.
+	if (dst[0] < src[0] && src[0] < dst[1])
+		return CastCategory::Trivial;
+	//Everything else is at the same offset as in the root.
+	auto begin = ancestors + src[2];
+	auto end = ancestors + src[3];
+	auto it = std::lower_bound(begin, end, dst_type);
+	if (it == end || *it != dst_type)
+		return CastCategory::Invalid;
+	//Virtual bases, and non-virtual ones before the root has been constructed,
+	//are found with RTTI.
+	auto learned = offsets[it - ancestors];
+	if (!learned)
+		return CastCategory::Complex;
+	auto value = learned->load(std::memory_order_relaxed);
+	if (value == unknown_base_offset)
+		return CastCategory::Complex;
+	offset = value;
+	return CastCategory::Trivial;
 }}
 )file";
 
@@ -1538,9 +1519,14 @@ CastCategory {name}(std::uint32_t src_type, std::uint32_t dst_type){{
 	for (auto &kv : this->type_map)
 		max_type = std::max(max_type, kv.first);
 
+	std::string hierarchy, ancestors, offsets;
+	this->generate_class_hierarchy(max_type, hierarchy, ancestors, offsets);
+
 	return variable_formatter(format)
 		<< "name" << get_categorize_cast_function_name()
-		<< "categories" << this->generate_cast_categories(max_type)
+		<< "hierarchy" << hierarchy
+		<< "ancestors" << ancestors
+		<< "offsets" << offsets
 		<< "max_type" << max_type
 	;
 }
@@ -1656,20 +1642,25 @@ std::string CppFile::get_id_hashes_name(){
 std::string CppFile::generate_get_metadata(){
 	static const char * const format2 = R"file(
 {get_metadata_signature}{{
-	std::shared_ptr<SerializableMetadata> ret(new SerializableMetadata);
-	ret->set_functions(
-		{allocator},
-		{constructor},
-		{rollbacker},
-		{is_serializable},
-		{dynamic_cast},
-		{allocate_pointer},
-		{categorize_cast},
-		{check_enum}
-	);
-	for (auto &[id, hash] : {array_name})
-		ret->add_type(id, hash);
-	return ret;
+	//Built only once, and never modified afterwards.
+	static const std::shared_ptr<const SerializableMetadata> metadata = [](){{
+		auto ret = std::make_shared<SerializableMetadata>();
+		ret->set_functions(
+			{allocator},
+			{constructor},
+			{rollbacker},
+			{is_serializable},
+			{dynamic_cast},
+			{categorize_cast},
+			{check_enum},
+			{object_layout},
+			{destructor}
+		);
+		for (auto &[id, hash] : {array_name})
+			ret->add_type(id, hash);
+		return ret;
+	}}();
+	return metadata;
 }}
 )file";
 
@@ -1680,9 +1671,10 @@ std::string CppFile::generate_get_metadata(){
 		<< "rollbacker" << get_rollbacker_function_name()
 		<< "is_serializable" << get_is_serializable_function_name()
 		<< "dynamic_cast" << get_dynamic_cast_function_name()
-		<< "allocate_pointer" << get_allocate_pointer_function_name()
 		<< "categorize_cast" << get_categorize_cast_function_name()
 		<< "check_enum" << get_check_enum_function_name()
+		<< "object_layout" << get_object_layout_function_name()
+		<< "destructor" << get_destructor_function_name()
 		<< "array_name" << this->get_id_hashes_name()
 	;
 }
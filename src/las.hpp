@@ -261,6 +261,24 @@ public:
 	}
 };
 
+//Non-owning view of a string or byte array in the input buffer. Same wire
+//format as string and vector<u8>, respectively.
+class BufferViewType : public Type{
+	bool bytes;
+public:
+	BufferViewType(bool bytes): bytes(bytes){}
+	using Type::get_source_name;
+	std::string get_source_name() const override{
+		return this->bytes ? "buffer_view<std::uint8_t>" : "buffer_view<char>";
+	}
+	const char *header() const override{
+		return "<cstdint>";
+	}
+	std::string get_serializer_name() const override{
+		return this->bytes ? "vector<u8>" : "str";
+	}
+};
+
 class DatetimeTime : public Type{
 public:
 	std::string get_source_name() const override{
@@ -549,18 +567,30 @@ public:
 	}
 };
 
+//How a member is written, when it isn't the default for its type.
+enum class MemberEncoding{
+	Default,
+	//vector<double> with gorilla.hpp.
+	Gorilla,
+};
+
 class ClassMember : public Object, public ClassElement{
 	Accessibility accessibility;
+	MemberEncoding encoding;
 public:
-	ClassMember(const std::shared_ptr<Type> &type, const std::string &name, Accessibility accessibility):
+	ClassMember(const std::shared_ptr<Type> &type, const std::string &name, Accessibility accessibility, MemberEncoding encoding = MemberEncoding::Default):
 		Object(type, name),
-		accessibility(accessibility){}
+		accessibility(accessibility),
+		encoding(encoding){}
 	std::string output() const override{
 		return (std::string)to_string(this->accessibility) + ": " + this->Object::output();
 	}
 	Accessibility get_accessibility() const{
 		return this->accessibility;
 	}
+	MemberEncoding get_encoding() const{
+		return this->encoding;
+	}
 	CppVersion minimum_cpp_version() const override{
 		return this->get_type()->minimum_cpp_version();
 	}
@@ -629,6 +659,16 @@ public:
 	void add_base_class(const std::shared_ptr<UserClass> &base){
 		this->base_classes.emplace_back(base);
 	}
+	const std::vector<InheritanceEdge> &get_base_classes() const{
+		return this->base_classes;
+	}
+	//Whether this class is the root of a tree in the single inheritance forest.
+	bool is_inheritance_root() const{
+		return this->base_classes.size() != 1 || this->base_classes.front().Virtual;
+	}
+	//type -> (class, whether it's reached through a virtual base), for every
+	//class this one inherits from, directly or not.
+	std::map<std::uint32_t, std::pair<UserClass *, bool>> get_ancestors() const;
 	void add_element(const std::shared_ptr<ClassElement> &member){
 		this->elements.emplace_back(member);
 	}
@@ -639,6 +679,7 @@ public:
 	void generate_get_object_node2(std::ostream &) const;
 	void generate_pointer_enumerator(generate_pointer_enumerator_callback_t &callback, const std::string &this_name) const override;
 	void generate_serialize(std::ostream &) const;
+	void generate_serialized_size(std::ostream &) const;
 	void generate_get_metadata(std::ostream &) const;
 	void generate_deserializer(std::ostream &) const;
 	const TypeHash &get_type_hash() override{
@@ -659,6 +700,7 @@ public:
 	}
 	DEFINE_GENERATE_OVERLOAD(generate_get_object_node2)
 	DEFINE_GENERATE_OVERLOAD(generate_serialize)
+	DEFINE_GENERATE_OVERLOAD(generate_serialized_size)
 	DEFINE_GENERATE_OVERLOAD(generate_get_type_hash)
 	DEFINE_GENERATE_OVERLOAD(generate_get_metadata)
 	DEFINE_GENERATE_OVERLOAD(generate_deserializer)
@@ -728,18 +770,12 @@ class CppFile{
 	type_map_t type_map;
 
 	std::string generate_sizes();
+	std::string generate_alignments();
 	std::string generate_deserializers();
 	std::string generate_rollbackers();
+	std::string generate_destructors();
 	std::string generate_dynamic_casts();
-	std::string generate_cast_cases(UserClass &, const char *format);
-	std::string generate_raw_pointer_cast_cases(UserClass &);
-	std::string generate_shared_ptr_cast_cases(UserClass &);
-	std::string generate_unique_ptr_cast_cases(UserClass &);
-	std::string generate_allocator_cases(const char *format);
-	std::string generate_raw_pointer_allocator_cases();
-	std::string generate_shared_pointer_allocator_cases();
-	std::string generate_unique_ptr_allocator_cases();
-	std::string generate_cast_categories(unsigned max_type);
+	void generate_class_hierarchy(unsigned max_type, std::string &hierarchy, std::string &ancestors, std::string &offsets);
 	std::string generate_type_comments();
 	std::string generate_type_map();
 	std::string get_id_hashes_name();
@@ -769,12 +805,10 @@ public:
 	std::string generate_allocator();
 	std::string generate_constructor();
 	std::string generate_rollbacker();
+	std::string generate_object_layout();
+	std::string generate_destructor();
 	std::string generate_is_serializable();
 	std::string generate_dynamic_cast();
-	std::string generate_generic_pointer_classes();
-	std::string generate_generic_pointer_class_implementations();
-	std::string generate_generic_pointer_classes_and_implementations();
-	std::string generate_pointer_allocator();
 	std::string generate_cast_categorizer();
 	std::string generate_enum_checker();
 	std::string generate_enum_stringifiers();
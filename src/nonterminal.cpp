@@ -329,6 +329,8 @@ std::shared_ptr<ClassInternalNonTerminal> ClassInternalNonTerminal::create(std::
 			return std::make_shared<CustomDtorNonTerminal>(input);
 		case FixedTokenType::Dollar:
 			return std::make_shared<NamedVerbatimUseNonTerminal>(input);
+		case FixedTokenType::Gorilla:
+			return std::make_shared<DataDeclarationNonTerminal>(input);
 		default:
 			break;
 	}
@@ -382,6 +384,12 @@ std::shared_ptr<CppElement> IncludeDirectiveNonTerminal::generate_element(CppFil
 DataDeclarationNonTerminal::DataDeclarationNonTerminal(std::deque<std::shared_ptr<Token>> &input){
 	if (!input.size())
 		throw ParsingError();
+	if (*input.front() == FixedTokenType::Gorilla){
+		this->encoding = MemberEncoding::Gorilla;
+		input.pop_front();
+		if (!input.size())
+			throw ParsingError();
+	}
 	if (input.front()->token_type() == TokenType::FixedToken){
 		auto type = std::static_pointer_cast<FixedToken>(input.front())->get_type();
 		if (!is_typename_token(type))
@@ -441,6 +449,8 @@ std::shared_ptr<TypeSpecificationNonTerminal> TypeSpecificationNonTerminal::crea
 		case FixedTokenType::Double:
 		case FixedTokenType::String:
 		case FixedTokenType::U32String:
+		case FixedTokenType::StringView:
+		case FixedTokenType::BytesView:
 			input.pop_front();
 			return std::make_shared<NullaryTypeSpecificationNonTerminal>(type);
 		case FixedTokenType::Pointer:
@@ -683,10 +693,14 @@ void AccessSpecifierNonTerminal::modify_class(const std::shared_ptr<UserClass> &
 
 void DataDeclarationNonTerminal::modify_class(const std::shared_ptr<UserClass> &Class, Accessibility &current_accessibility, CppEvaluationState &state) const{
 	auto type = this->type->create_type(state.dsl_type_map);
+	auto name = this->name->get_name();
+	//Checked on the declared type; an array of vector<double> can't be
+	//gorilla-coded.
+	if (this->encoding == MemberEncoding::Gorilla && (this->length || type->get_serializer_name() != "vector<double>"))
+		throw std::runtime_error("member " + name + " can't be declared gorilla; only vector<double> members can");
 	if (this->length)
 		type = std::make_shared<ArrayType>(type, this->length->get_value());
-	auto name = this->name->get_name();
-	auto member = std::make_shared<ClassMember>(type, name, current_accessibility);
+	auto member = std::make_shared<ClassMember>(type, name, current_accessibility, this->encoding);
 	Class->add_element(member);
 }
 
@@ -744,6 +758,10 @@ std::shared_ptr<Type> NullaryTypeSpecificationNonTerminal::create_type(dsl_type_
 			return std::make_shared<StringType>(CharacterWidth::Narrow);
 		case FixedTokenType::U32String:
 			return std::make_shared<StringType>(CharacterWidth::Wide);
+		case FixedTokenType::StringView:
+			return std::make_shared<BufferViewType>(false);
+		case FixedTokenType::BytesView:
+			return std::make_shared<BufferViewType>(true);
 		default:
 			throw std::runtime_error("Internal error: program in unknown state!");
 	}
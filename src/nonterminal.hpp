@@ -87,6 +87,7 @@ public:
 };
 
 class DataDeclarationNonTerminal : public ClassInternalNonTerminal{
+	MemberEncoding encoding = MemberEncoding::Default;
 	std::shared_ptr<TypeSpecificationNonTerminal> type;
 	std::shared_ptr<IdentifierToken> name;
 	std::shared_ptr<IntegerToken> length;
@@ -48,6 +48,9 @@ const char *const keywords[] = {
 	"custom_dtor",
 	"namespace",
 	"enum",
+	"string_view",
+	"bytes_view",
+	"gorilla",
 	nullptr,
 };
 
@@ -261,6 +264,8 @@ bool is_typename_token(FixedTokenType type){
 		case FixedTokenType::UnorderedMap:
 		case FixedTokenType::String:
 		case FixedTokenType::U32String:
+		case FixedTokenType::StringView:
+		case FixedTokenType::BytesView:
 		case FixedTokenType::Optional:
 			return true;
 	}
@@ -70,6 +70,9 @@ enum class FixedTokenType{
 	CustomDtor    = first_name_token + 35,
 	Namespace     = first_name_token + 36,
 	Enum          = first_name_token + 37,
+	StringView    = first_name_token + 38,
+	BytesView     = first_name_token + 39,
+	Gorilla       = first_name_token + 40,
 };
 
 enum class AccessType{
@@ -1,6 +1,10 @@
 #include "tests.hpp"
+#include <string>
 
-int main(){
-	run_tests();
+int main(int argc, char **argv){
+	if (argc > 1 && std::string(argv[1]) == "--benchmark")
+		run_benchmarks();
+	else
+		run_tests();
 	return 0;
 }
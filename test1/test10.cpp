@@ -0,0 +1,78 @@
+#include "test10.generated.hpp"
+#include "test10.generated.cpp"
+#include "test2.generated.hpp"
+#include "util.hpp"
+#include <random>
+#include <algorithm>
+
+using namespace test10_types;
+
+int Node::destroyed = 0;
+
+void test10(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	const int n = 100;
+	std::vector<std::unique_ptr<Node>> storage;
+	Graph graph;
+	for (int i = 0; i < n; i++){
+		storage.push_back(std::make_unique<Node>());
+		storage.back()->value = rng();
+		graph.nodes.push_back(storage.back().get());
+	}
+	for (int i = 0; i < n / 10; i++){
+		graph.leaves.push_back(std::make_shared<Leaf>());
+		graph.leaves.back()->name = std::to_string(rng());
+		graph.leaves.back()->weight = (double)rng() / 7;
+	}
+	for (int i = 0; i < n; i++){
+		graph.nodes[i]->next = graph.nodes[rng() % n];
+		graph.nodes[i]->leaf = graph.leaves[rng() % graph.leaves.size()];
+	}
+	auto serialized = serialize(graph);
+
+	auto check = [&](const Graph &graph2){
+		test_assertion(graph2.nodes.size() == n, "wrong number of nodes");
+		test_assertion(graph2.leaves.size() == graph.leaves.size(), "wrong number of leaves");
+		for (int i = 0; i < n; i++){
+			auto &a = *graph.nodes[i];
+			auto &b = *graph2.nodes[i];
+			test_assertion(a.value == b.value, "wrong value");
+			auto next = std::find(graph.nodes.begin(), graph.nodes.end(), a.next) - graph.nodes.begin();
+			test_assertion(b.next == graph2.nodes[next], "wrong link");
+			auto leaf = std::find(graph.leaves.begin(), graph.leaves.end(), a.leaf) - graph.leaves.begin();
+			test_assertion(b.leaf == graph2.leaves[leaf], "wrong leaf");
+			test_assertion(b.leaf->name == a.leaf->name && b.leaf->weight == a.leaf->weight, "wrong leaf data");
+		}
+	};
+
+	Node::destroyed = 0;
+	{
+		DeserializerStream ds(serialized.data(), serialized.size());
+		auto graph2 = ds.full_deserialization_arena<Graph>(true);
+		test_assertion(!!graph2, "failed to deserialize");
+		check(*graph2);
+		//All nodes are consecutive in memory.
+		std::vector<Node *> sorted = graph2->nodes;
+		std::sort(sorted.begin(), sorted.end());
+		for (int i = 1; i < n; i++)
+			test_assertion(sorted[i] == sorted[i - 1] + 1, "nodes aren't contiguous");
+	}
+	test_assertion(Node::destroyed == n, "arena didn't destroy the graph");
+
+	//Objects owned by std::unique_ptr can't be allocated from an arena.
+	{
+		test2_types::Root root;
+		root.nodes.push_back(std::make_unique<test2_types::Node>());
+		root.nodes.back()->data = 1;
+		root.root = root.nodes.back().get();
+		auto serialized_root = serialize(root);
+		DeserializerStream ds(serialized_root.data(), serialized_root.size());
+		bool thrown = false;
+		try{
+			ds.full_deserialization_arena<test2_types::Root>(true);
+		}catch (DeserializationException &e){
+			thrown = e.get_type() == DeserializerStream::ErrorType::UniquePtrInArena;
+		}
+		test_assertion(thrown, "unique_ptr wasn't rejected");
+	}
+}
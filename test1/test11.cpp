@@ -0,0 +1,141 @@
+#include "test11.generated.hpp"
+#include "test11.generated.cpp"
+#include "test2.generated.hpp"
+#include "util.hpp"
+#include <LazyDeserializer.hpp>
+#include <random>
+#include <set>
+
+using namespace test11_types;
+
+int Record::destroyed = 0;
+
+void test11(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	const int n = 100;
+	std::vector<std::unique_ptr<Record>> storage;
+	Index index;
+	for (int i = 0; i < n; i++){
+		storage.push_back(std::make_unique<Record>());
+		storage.back()->value = rng();
+		//Records form a single chain.
+		storage.back()->next = i ? storage[i - 1].get() : nullptr;
+		index.records.push_back(storage.back().get());
+	}
+	std::set<std::string> names;
+	for (int i = 0; i < n / 10; i++){
+		index.blobs.push_back(std::make_shared<Blob>());
+		index.blobs.back()->name = std::to_string(i) + "_" + std::to_string(rng());
+		index.blobs.back()->weight = i;
+		names.insert(index.blobs.back()->name);
+	}
+	for (int i = 0; i < n; i++)
+		index.records[i]->blob = index.blobs[rng() % index.blobs.size()];
+
+	std::string serialized;
+	{
+		StringSink sink(serialized);
+		SerializerStream ss(sink);
+		SerializerStream::Options options;
+		options.include_typehashes = true;
+		options.include_offset_table = true;
+		ss.full_serialization(index, options);
+	}
+
+	//The regular deserializer just skips the table.
+	{
+		DeserializerStream::Options options;
+		options.includes_typehashes = true;
+		options.includes_offset_table = true;
+		DeserializerStream ds(serialized.data(), serialized.size());
+		auto index2 = ds.full_deserialization_arena<Index>(options);
+		test_assertion(index2->records.size() == n, "failed check #1");
+		for (int i = 0; i < n; i++)
+			test_assertion(index2->records[i]->value == index.records[i]->value, "failed check #2");
+	}
+
+	Record::destroyed = 0;
+	{
+		DeserializerStream::Options options;
+		options.includes_typehashes = true;
+		LazyDeserializer lazy(serialized.data(), serialized.size(), Index::static_get_metadata(), options);
+		test_assertion(lazy.get_object_count() == 1 + n + n / 10, "failed check #3");
+		test_assertion(!lazy.get_decoded_count(), "failed check #4");
+
+		//Leaves don't point to anything, so they can be decoded one by one.
+		std::set<std::string> names2;
+		for (LazyDeserializer::objectid_t oid = 1; oid <= lazy.get_object_count(); oid++){
+			if (lazy.get_object_type(oid) != static_get_type_id<Blob>::value)
+				continue;
+			auto blob = lazy.get_object<Blob>(oid);
+			test_assertion(blob && lazy.get_object<Blob>(oid) == blob, "failed check #5");
+			names2.insert(blob->name);
+			test_assertion(lazy.get_decoded_count() == names2.size(), "failed check #6");
+		}
+		test_assertion(names == names2, "failed check #7");
+
+		//Decoding the root decodes everything else.
+		auto index2 = lazy.get_root<Index>();
+		test_assertion(!!index2, "failed check #8");
+		test_assertion(lazy.get_decoded_count() == lazy.get_object_count(), "failed check #9");
+		for (int i = 0; i < n; i++){
+			auto &a = *index.records[i];
+			auto &b = *index2->records[i];
+			test_assertion(a.value == b.value, "failed check #10");
+			test_assertion(!a.next == !b.next && (!a.next || a.next->value == b.next->value), "failed check #11");
+			test_assertion(a.blob->name == b.blob->name, "failed check #12");
+		}
+	}
+	test_assertion(Record::destroyed == n, "failed check #13");
+
+	//Objects owned by std::unique_ptr can't be decoded lazily.
+	{
+		test2_types::Root root;
+		root.nodes.push_back(std::make_unique<test2_types::Node>());
+		root.nodes.back()->data = 1;
+		root.root = root.nodes.back().get();
+		std::string serialized_root;
+		{
+			StringSink sink(serialized_root);
+			SerializerStream ss(sink);
+			SerializerStream::Options options;
+			options.include_offset_table = true;
+			ss.full_serialization(root, options);
+		}
+		LazyDeserializer lazy(serialized_root.data(), serialized_root.size(), test2_types::Root::static_get_metadata());
+		bool thrown = false;
+		try{
+			lazy.get_root<test2_types::Root>();
+		}catch (DeserializationException &e){
+			thrown = e.get_type() == DeserializerStream::ErrorType::UniquePtrInArena;
+		}
+		test_assertion(thrown, "failed check #14");
+		test_assertion(!lazy.get_decoded_count(), "failed check #15");
+	}
+
+	//Type hashes and a type map can be used together.
+	{
+		std::unordered_map<std::uint32_t, std::uint32_t> to_wire, from_wire;
+		for (std::uint32_t t = 0; t < 64; t++){
+			to_wire[t] = t + 1000;
+			from_wire[t + 1000] = t;
+		}
+		std::string mapped;
+		{
+			StringSink sink(mapped);
+			SerializerStream ss(sink);
+			SerializerStream::Options options;
+			options.include_typehashes = true;
+			options.type_map = &to_wire;
+			ss.full_serialization(index, options);
+		}
+		DeserializerStream::Options options;
+		options.includes_typehashes = true;
+		options.type_map = &from_wire;
+		DeserializerStream ds(mapped.data(), mapped.size());
+		auto index2 = ds.full_deserialization_arena<Index>(options);
+		test_assertion(index2 && index2->records.size() == n, "failed check #16");
+		for (int i = 0; i < n; i++)
+			test_assertion(index2->records[i]->value == index.records[i]->value, "failed check #17");
+	}
+}
@@ -0,0 +1,74 @@
+#include "test10.generated.hpp"
+#include "util.hpp"
+#include <random>
+
+using namespace test10_types;
+
+void test12(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	const int n = 10000;
+	std::vector<std::unique_ptr<Node>> storage;
+	Graph graph;
+	for (int i = 0; i < n; i++){
+		storage.push_back(std::make_unique<Node>());
+		storage.back()->value = rng();
+		graph.nodes.push_back(storage.back().get());
+	}
+	for (int i = 0; i < n / 10; i++){
+		graph.leaves.push_back(std::make_shared<Leaf>());
+		graph.leaves.back()->name = std::to_string(rng());
+		graph.leaves.back()->weight = i;
+	}
+	for (int i = 0; i < n; i++){
+		graph.nodes[i]->next = graph.nodes[rng() % n];
+		graph.nodes[i]->leaf = graph.leaves[rng() % graph.leaves.size()];
+	}
+
+	std::string serialized;
+	{
+		StringSink sink(serialized);
+		SerializerStream ss(sink);
+		SerializerStream::Options options;
+		options.include_typehashes = true;
+		options.include_offset_table = true;
+		ss.full_serialization(graph, options);
+	}
+
+	DeserializerStream::Options options;
+	options.includes_typehashes = true;
+	options.includes_offset_table = true;
+	options.decoding_threads = 8;
+	{
+		DeserializerStream ds(serialized.data(), serialized.size());
+		auto graph2 = ds.full_deserialization_arena<Graph>(options);
+		test_assertion(graph2->nodes.size() == n, "failed check #1");
+		test_assertion(graph2->leaves.size() == graph.leaves.size(), "failed check #2");
+		for (int i = 0; i < n; i++){
+			auto &a = *graph.nodes[i];
+			auto &b = *graph2->nodes[i];
+			test_assertion(a.value == b.value, "failed check #3");
+			test_assertion(a.next->value == b.next->value, "failed check #4");
+			test_assertion(a.leaf->name == b.leaf->name, "failed check #5");
+		}
+		//Pointers to the same object must share ownership, even if they were
+		//decoded on different threads.
+		for (int i = 0; i < n; i++){
+			auto &a = *graph.nodes[i];
+			auto &b = *graph2->nodes[i];
+			test_assertion(a.leaf.use_count() == b.leaf.use_count(), "failed check #6");
+		}
+	}
+
+	//Errors on any thread are reported normally.
+	{
+		auto truncated = serialized.substr(0, serialized.size() - 1);
+		DeserializerStream ds(truncated.data(), truncated.size());
+		bool thrown = false;
+		try{
+			ds.full_deserialization_arena<Graph>(options);
+		}catch (DeserializationException &e){
+			thrown = e.get_type() == DeserializerStream::ErrorType::UnexpectedEndOfFile;
+		}
+		test_assertion(thrown, "failed check #7");
+	}
+}
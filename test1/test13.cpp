@@ -0,0 +1,52 @@
+#include "test10.generated.hpp"
+#include "util.hpp"
+#include <random>
+
+using namespace test10_types;
+
+static std::string serialize(const Serializable &src, bool include_offset_table, unsigned threads){
+	std::string ret;
+	StringSink sink(ret);
+	SerializerStream ss(sink);
+	SerializerStream::Options options;
+	options.include_typehashes = true;
+	options.include_offset_table = include_offset_table;
+	options.encoding_threads = threads;
+	ss.full_serialization(src, options);
+	return ret;
+}
+
+void test13(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	const int n = 10000;
+	std::vector<std::unique_ptr<Node>> storage;
+	Graph graph;
+	for (int i = 0; i < n; i++){
+		storage.push_back(std::make_unique<Node>());
+		storage.back()->value = rng();
+		graph.nodes.push_back(storage.back().get());
+	}
+	for (int i = 0; i < n / 10; i++){
+		graph.leaves.push_back(std::make_shared<Leaf>());
+		graph.leaves.back()->name = std::string(rng() % 100, 'a' + i % 26);
+		graph.leaves.back()->weight = (double)rng() / 3;
+	}
+	for (int i = 0; i < n; i++){
+		graph.nodes[i]->next = rng() % 4 ? graph.nodes[rng() % n] : nullptr;
+		graph.nodes[i]->leaf = graph.leaves[rng() % graph.leaves.size()];
+	}
+
+	//The output doesn't depend on the number of threads.
+	for (bool table : { false, true }){
+		auto expected = serialize(graph, table, 1);
+		for (unsigned threads : { 2, 3, 8, 64 })
+			test_assertion(serialize(graph, table, threads) == expected, "failed check #1");
+	}
+	//More threads than objects.
+	{
+		Leaf leaf;
+		leaf.name = "leaf";
+		leaf.weight = 1;
+		test_assertion(serialize(leaf, true, 4) == serialize(leaf, true, 1), "failed check #2");
+	}
+}
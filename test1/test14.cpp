@@ -0,0 +1,70 @@
+#include "test10.generated.hpp"
+#include "util.hpp"
+#include <random>
+
+using namespace test10_types;
+
+static std::string serialize(const Serializable &src, bool remap_object_ids, unsigned traversal_threads, unsigned encoding_threads){
+	std::string ret;
+	StringSink sink(ret);
+	SerializerStream ss(sink);
+	SerializerStream::Options options;
+	options.include_typehashes = true;
+	options.remap_object_ids = remap_object_ids;
+	options.traversal_threads = traversal_threads;
+	options.encoding_threads = encoding_threads;
+	ss.full_serialization(src, options);
+	return ret;
+}
+
+void test14(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	const int n = 20000;
+	std::vector<std::unique_ptr<Node>> storage;
+	Graph graph;
+	for (int i = 0; i < n; i++){
+		storage.push_back(std::make_unique<Node>());
+		storage.back()->value = rng();
+	}
+	//Only a few nodes are reachable directly from the root. The rest are
+	//reachable through long chains with cycles.
+	for (int i = 0; i < n; i += 1000)
+		graph.nodes.push_back(storage[i].get());
+	for (int i = 0; i < n / 10; i++){
+		graph.leaves.push_back(std::make_shared<Leaf>());
+		graph.leaves.back()->name = std::string(rng() % 100, 'a' + i % 26);
+		graph.leaves.back()->weight = (double)rng() / 3;
+	}
+	for (int i = 0; i < n; i++){
+		storage[i]->next = rng() % 8 ? storage[(i + 1) % n].get() : storage[rng() % n].get();
+		storage[i]->leaf = graph.leaves[rng() % graph.leaves.size()];
+	}
+
+	//The output doesn't depend on the number of threads.
+	for (bool remap : { true, false }){
+		auto expected = serialize(graph, remap, 1, 1);
+		for (unsigned threads : { 2, 3, 8 }){
+			test_assertion(serialize(graph, remap, threads, 1) == expected, "failed check #1");
+			test_assertion(serialize(graph, remap, threads, threads) == expected, "failed check #2");
+		}
+	}
+	//A single object.
+	{
+		Leaf leaf;
+		leaf.name = "leaf";
+		leaf.weight = 1;
+		test_assertion(serialize(leaf, true, 4, 1) == serialize(leaf, true, 1, 1), "failed check #3");
+	}
+	//The result can be read back.
+	{
+		std::string s = serialize(graph, true, 4, 1);
+		MemorySource source(s.data(), s.size());
+		DeserializerStream ds(source);
+		auto graph2 = ds.full_deserialization_arena<Graph>(true);
+		test_assertion(graph2->nodes.size() == graph.nodes.size(), "failed check #4");
+		auto a = graph.nodes[3];
+		auto b = graph2->nodes[3];
+		for (int i = 0; i < 100 && a; i++, a = a->next, b = b->next)
+			test_assertion(b && a->value == b->value && a->leaf->name == b->leaf->name, "failed check #5");
+	}
+}
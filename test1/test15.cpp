@@ -0,0 +1,107 @@
+#include "test15.generated.hpp"
+#include "test15.generated.cpp"
+#include "gen.hpp"
+#include "util.hpp"
+
+using namespace test15_types;
+
+static std::uint64_t measure(const Serializable &src, const SerializerStream::Options &options){
+	std::string unused;
+	StringSink sink(unused);
+	SerializerStream ss(sink);
+	auto ret = ss.compute_serialized_size(src, options);
+	test_assertion(!!ret, "failed check #1");
+	test_assertion(unused.empty(), "failed check #2");
+	return *ret;
+}
+
+void test15(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	const int n = 200;
+	Root root;
+	for (int i = 0; i < n / 4; i++){
+		root.strings.push_back(std::make_shared<std::string>());
+		gen(*root.strings.back(), rng);
+	}
+	auto note = std::make_shared<std::string>();
+	gen(*note, rng);
+	for (int i = 0; i < n; i++){
+		root.items.push_back(std::make_unique<Item>());
+		auto &item = *root.items.back();
+		gen(item.name, rng);
+		gen(item.id, rng);
+		item.kind = rng() % 2 ? Kind::Small : Kind::Large;
+		item.flag = rng() % 2;
+		for (auto &x : item.digest)
+			gen(x, rng);
+		item.samples.resize(rng() % 20);
+		for (auto &x : item.samples)
+			gen(x, rng);
+		item.values.resize(rng() % 20);
+		for (auto &x : item.values)
+			gen(x, rng);
+		item.bytes.resize(rng() % 300);
+		for (int j = rng() % 10; j--;){
+			std::string key;
+			gen(key, rng);
+			gen(item.counts[key], rng);
+		}
+		for (int j = rng() % 10; j--;){
+			std::int16_t x;
+			gen(x, rng);
+			item.tags.insert(x);
+		}
+		for (int j = rng() % 10; j--;){
+			std::uint64_t x;
+			gen(x, rng);
+			item.hashes.insert(x);
+		}
+		if (rng() % 2)
+			gen(item.label, rng);
+		if (rng() % 2)
+			item.alias = root.strings[rng() % root.strings.size()].get();
+		if (rng() % 2)
+			item.note = note;
+	}
+	for (int i = 0; i < n; i++){
+		if (rng() % 4)
+			root.items[i]->next = root.items[rng() % n].get();
+		if (rng() % 3 == 0)
+			gen(root.names[rng()], rng);
+	}
+
+	//The precomputed size matches the actual size for every combination of
+	//options that affects the output.
+	for (int i = 0; i < 64; i++){
+		SerializerStream::Options options;
+		options.include_typehashes = !!(i & 1);
+		options.remap_object_ids = !!(i & 2);
+		options.include_offset_table = !!(i & 4);
+		options.wire_format = (i & 8 ? wire_flags::prefix_varints : 0) | (i & 16 ? wire_flags::block_integers : 0) | (i & 32 ? wire_flags::sorted_key_deltas : 0);
+		test_assertion(measure(root, options) == serialize(root, options).size(), "failed check #3");
+	}
+	//Measuring doesn't affect a later serialization on the same stream.
+	{
+		SerializerStream::Options options;
+		options.include_typehashes = true;
+		std::string s;
+		{
+			StringSink sink(s);
+			SerializerStream ss(sink);
+			auto size = ss.compute_serialized_size(root, options);
+			ss.full_serialization(root, options);
+			test_assertion(size && *size == s.size(), "failed check #4");
+		}
+		test_assertion(s == serialize(root, options), "failed check #5");
+	}
+	//A type map that doesn't cover every type.
+	{
+		std::unordered_map<std::uint32_t, std::uint32_t> type_map;
+		SerializerStream::Options options;
+		options.type_map = &type_map;
+		std::string unused;
+		StringSink sink(unused);
+		SerializerStream ss(sink);
+		test_assertion(!ss.compute_serialized_size(root, options), "failed check #6");
+	}
+}
@@ -0,0 +1,79 @@
+#include "test10.generated.hpp"
+#include "util.hpp"
+#include <random>
+#include <fstream>
+#include <cstdio>
+
+using namespace test10_types;
+
+static void check(const Graph &a, const Graph &b){
+	test_assertion(a.nodes.size() == b.nodes.size(), "failed check #1");
+	for (size_t i = 0; i < a.nodes.size(); i++){
+		test_assertion(a.nodes[i]->value == b.nodes[i]->value, "failed check #2");
+		test_assertion(a.nodes[i]->next->value == b.nodes[i]->next->value, "failed check #3");
+		test_assertion(a.nodes[i]->leaf->name == b.nodes[i]->leaf->name, "failed check #4");
+	}
+}
+
+void test16(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	const int n = 10000;
+	std::vector<std::unique_ptr<Node>> storage;
+	Graph graph;
+	for (int i = 0; i < n; i++){
+		storage.push_back(std::make_unique<Node>());
+		storage.back()->value = rng();
+		graph.nodes.push_back(storage.back().get());
+	}
+	for (int i = 0; i < n / 10; i++){
+		graph.leaves.push_back(std::make_shared<Leaf>());
+		graph.leaves.back()->name = std::string(rng() % 10000, 'a' + i % 26);
+		graph.leaves.back()->weight = i;
+	}
+	for (int i = 0; i < n; i++){
+		graph.nodes[i]->next = graph.nodes[rng() % n];
+		graph.nodes[i]->leaf = graph.leaves[rng() % graph.leaves.size()];
+	}
+
+	const char *path = "test16.tmp";
+	{
+		std::ofstream file(path, std::ios::binary);
+		SerializerStream ss(file);
+		SerializerStream::Options options;
+		options.include_typehashes = true;
+		options.include_offset_table = true;
+		ss.full_serialization(graph, options);
+	}
+
+	DeserializerStream::Options options;
+	options.includes_typehashes = true;
+	options.includes_offset_table = true;
+	//Small windows, so that strings and integers straddle them.
+	for (size_t window : { (size_t)1, (size_t)4096, MappedFileSource::default_window_size }){
+		for (bool drop_behind : { true, false }){
+			MappedFileSource source(path, drop_behind, window);
+			DeserializerStream ds(source);
+			auto graph2 = ds.full_deserialization_arena<Graph>(options);
+			check(graph, *graph2);
+			test_assertion(source.position() == source.size(), "failed check #5");
+		}
+	}
+	//Parallel decoding needs every object body at once.
+	{
+		MappedFileSource source(path, true, 4096);
+		DeserializerStream ds(source);
+		auto options2 = options;
+		options2.decoding_threads = 4;
+		auto graph2 = ds.full_deserialization_arena<Graph>(options2);
+		check(graph, *graph2);
+	}
+	std::remove(path);
+
+	bool thrown = false;
+	try{
+		MappedFileSource source(path);
+	}catch (std::system_error &){
+		thrown = true;
+	}
+	test_assertion(thrown, "failed check #6");
+}
@@ -0,0 +1,136 @@
+#include "test17.generated.hpp"
+#include "test17.generated.cpp"
+#include "util.hpp"
+#include <random>
+#include <fstream>
+#include <cstdio>
+
+using namespace test17_types;
+
+static bool points_into(const void *p, size_t size, const void *buffer, size_t buffer_size){
+	auto q = (const char *)p;
+	auto begin = (const char *)buffer;
+	return q >= begin && q + size <= begin + buffer_size;
+}
+
+static void check(const Message &a, const Message &b){
+	test_assertion(a.title == b.title, "failed check #1");
+	test_assertion(a.payload == b.payload, "failed check #2");
+	test_assertion(a.parts == b.parts, "failed check #3");
+	test_assertion(a.copied == b.copied, "failed check #4");
+	test_assertion(a.children.size() == b.children.size(), "failed check #5");
+	for (size_t i = 0; i < a.children.size(); i++)
+		check(*a.children[i], *b.children[i]);
+}
+
+//Checks that every non-empty view in the message points into the buffer and
+//shares ownership of it.
+static void check_borrowed(const Message &m, const void *buffer, size_t size, const std::shared_ptr<const void> &owner, bool expected){
+	auto check_view = [&](const auto &v){
+		if (v.empty())
+			return;
+		test_assertion(points_into(v.data(), v.size(), buffer, size) == expected, "failed check #6");
+		test_assertion((v.get_owner() == owner) == expected, "failed check #7");
+	};
+	check_view(m.title);
+	check_view(m.payload);
+	for (auto &part : m.parts)
+		check_view(part);
+	for (auto &child : m.children)
+		check_borrowed(*child, buffer, size, owner, expected);
+}
+
+void test17(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	std::vector<std::string> strings;
+	for (int i = 0; i < 100; i++)
+		strings.push_back(std::string(rng() % 5000, 'a' + i % 26));
+	auto random_view = [&](){
+		auto &s = strings[rng() % strings.size()];
+		return buffer_view<char>(s.data(), s.size() / 2, nullptr);
+	};
+
+	Message message;
+	message.title = buffer_view<char>::copy_of("title");
+	for (int i = 0; i < 10; i++){
+		message.children.push_back(std::make_shared<Message>());
+		auto &child = *message.children.back();
+		child.title = random_view();
+		auto &s = strings[rng() % strings.size()];
+		child.payload = buffer_view<std::uint8_t>((const std::uint8_t *)s.data(), s.size(), nullptr);
+		for (int j = rng() % 10; j--;)
+			child.parts.push_back(random_view());
+		child.copied = std::string(child.title.view());
+	}
+
+	SerializerStream::Options options;
+	options.include_offset_table = true;
+	auto serialized = std::make_shared<std::string>();
+	{
+		StringSink sink(*serialized);
+		SerializerStream ss(sink);
+		ss.full_serialization(message, options);
+		auto size = ss.compute_serialized_size(message, options);
+		test_assertion(size && *size == serialized->size(), "failed check #8");
+	}
+	//Views have the same wire format as strings and byte vectors.
+	{
+		std::string expected;
+		StringSink sink(expected);
+		SerializerStream ss(sink);
+		ss.serialize(std::string(message.title.view()));
+		ss.serialize(std::vector<std::uint8_t>(message.children[0]->payload.begin(), message.children[0]->payload.end()));
+		ss.flush();
+		std::string actual;
+		StringSink sink2(actual);
+		SerializerStream ss2(sink2);
+		ss2.serialize(message.title);
+		ss2.serialize(message.children[0]->payload);
+		ss2.flush();
+		test_assertion(expected == actual, "failed check #9");
+	}
+
+	DeserializerStream::Options doptions;
+	doptions.includes_offset_table = true;
+	//Borrowed from a buffer with an owner.
+	for (unsigned threads : { 1, 4 }){
+		auto data = serialized->data();
+		auto size = serialized->size();
+		std::shared_ptr<const void> owner = serialized;
+		std::shared_ptr<Message> message2;
+		{
+			MemorySource source(data, size, owner);
+			DeserializerStream ds(source);
+			auto o = doptions;
+			o.decoding_threads = threads;
+			message2 = ds.full_deserialization<Message>(o);
+		}
+		check(message, *message2);
+		check_borrowed(*message2, data, size, owner, true);
+	}
+	//Copied, if the buffer has no owner.
+	{
+		MemorySource source(serialized->data(), serialized->size());
+		DeserializerStream ds(source);
+		auto message2 = ds.full_deserialization<Message>(doptions);
+		check(message, *message2);
+		check_borrowed(*message2, serialized->data(), serialized->size(), nullptr, false);
+	}
+	//Views into a mapped file outlive the source.
+	{
+		const char *path = "test17.tmp";
+		{
+			std::ofstream file(path, std::ios::binary);
+			file.write(serialized->data(), serialized->size());
+		}
+		std::shared_ptr<Message> message2;
+		{
+			MappedFileSource source(path, true, 4096);
+			DeserializerStream ds(source);
+			message2 = ds.full_deserialization<Message>(doptions);
+			check_borrowed(*message2, source.get_data(), source.size(), source.get_owner(), true);
+		}
+		std::remove(path);
+		check(message, *message2);
+	}
+}
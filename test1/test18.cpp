@@ -0,0 +1,93 @@
+#include "test17.generated.hpp"
+#include "util.hpp"
+#include <random>
+#include <fstream>
+#include <cstdio>
+#if defined _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace test17_types;
+
+static std::string concatenate(const IovecSink &sink){
+	std::string ret;
+	for (auto &segment : sink.get_segments())
+		ret.append((const char *)segment.data, segment.size);
+	return ret;
+}
+
+void test18(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	std::vector<std::string> strings;
+	for (int i = 0; i < 100; i++)
+		strings.push_back(std::string(rng() % 20000, 'a' + i % 26));
+
+	Message message;
+	for (int i = 0; i < 100; i++){
+		message.children.push_back(std::make_shared<Message>());
+		auto &child = *message.children.back();
+		auto &s = strings[rng() % strings.size()];
+		child.title = buffer_view<char>(s.data(), s.size() / 3, nullptr);
+		child.payload = buffer_view<std::uint8_t>((const std::uint8_t *)s.data(), s.size(), nullptr);
+		child.copied = strings[rng() % strings.size()];
+	}
+
+	std::string expected;
+	{
+		StringSink sink(expected);
+		SerializerStream ss(sink);
+		ss.full_serialization(message);
+	}
+
+	for (size_t threshold : { (size_t)1, (size_t)100, IovecSink::default_reference_threshold, (size_t)SIZE_MAX }){
+		for (size_t block_size : { (size_t)64, IovecSink::default_block_size }){
+			IovecSink sink(threshold, block_size);
+			SerializerStream ss(sink);
+			ss.full_serialization(message);
+			test_assertion(concatenate(sink) == expected, "failed check #1");
+			test_assertion(sink.size() == expected.size(), "failed check #2");
+			//Large payloads are referenced, not copied.
+			for (auto &child : message.children){
+				bool found = false;
+				for (auto &segment : sink.get_segments())
+					found |= segment.data == child->payload.data() && segment.size == child->payload.size();
+				test_assertion(found == (child->payload.size() >= threshold), "failed check #3");
+			}
+
+			sink.clear();
+			test_assertion(sink.get_segments().empty() && !sink.size(), "failed check #4");
+			ss.full_serialization(message);
+			test_assertion(concatenate(sink) == expected, "failed check #5");
+		}
+	}
+
+	//Writing to a file.
+	{
+		IovecSink sink(1, 64);
+		SerializerStream ss(sink);
+		ss.full_serialization(message);
+		test_assertion(sink.get_segments().size() > 64, "failed check #6");
+		const char *path = "test18.tmp";
+#if defined _WIN32
+		auto fd = _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#else
+		auto fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+		test_assertion(fd >= 0, "failed check #7");
+		sink.write_to(fd);
+#if defined _WIN32
+		_close(fd);
+#else
+		close(fd);
+#endif
+		std::ifstream file(path, std::ios::binary);
+		std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		file.close();
+		std::remove(path);
+		test_assertion(contents == expected, "failed check #8");
+	}
+}
@@ -0,0 +1,109 @@
+#include "test19.generated.hpp"
+#include "test19.generated.cpp"
+#include "util.hpp"
+#include <random>
+
+using namespace test19_types;
+
+template <typename T, typename U>
+static bool same_owner(const std::shared_ptr<T> &a, const std::shared_ptr<U> &b){
+	return !a.owner_before(b) && !b.owner_before(a);
+}
+
+static const void *address_of(const Serializable *p){
+	return dynamic_cast<const void *>(p);
+}
+
+//Every pointer to the same object must point to it at the right address, and
+//every std::shared_ptr to it must share the same control block.
+static void check(const Graph &a, const Graph &b){
+	test_assertion(a.bases.size() == b.bases.size(), "failed check #1");
+	test_assertion(a.lefts.size() == b.lefts.size(), "failed check #2");
+	test_assertion(a.rights.size() == b.rights.size(), "failed check #3");
+	test_assertion(a.joined.size() == b.joined.size(), "failed check #4");
+	test_assertion(a.raw.size() == b.raw.size(), "failed check #5");
+	for (size_t i = 0; i < b.joined.size(); i++){
+		auto &j = b.joined[i];
+		test_assertion(j->extra == a.joined[i]->extra && j->value == a.joined[i]->value, "failed check #6");
+		auto &base = b.bases[i];
+		auto &left = b.lefts[i];
+		auto &right = b.rights[i];
+		test_assertion(base.get() == static_cast<Base *>(j.get()), "failed check #7");
+		test_assertion(left.get() == static_cast<Left *>(j.get()), "failed check #8");
+		test_assertion(right.get() == static_cast<Right *>(j.get()), "failed check #9");
+		test_assertion(left->left == a.lefts[i]->left && right->right == a.rights[i]->right, "failed check #10");
+		test_assertion(same_owner(j, base) && same_owner(j, left) && same_owner(j, right), "failed check #11");
+		test_assertion(j.use_count() == a.joined[i].use_count(), "failed check #12");
+		test_assertion(b.raw[i] == base.get(), "failed check #13");
+	}
+	test_assertion(a.owned.size() == b.owned.size() && a.owned_views.size() == b.owned_views.size(), "failed check #14");
+	for (size_t i = 0; i < b.owned.size(); i++){
+		test_assertion(b.owned[i]->value == a.owned[i]->value && b.owned[i]->left == a.owned[i]->left, "failed check #15");
+		test_assertion(b.owned_views[i] == b.owned[i].get(), "failed check #16");
+	}
+	test_assertion(a.shapes.size() == b.shapes.size() && a.circles.size() == b.circles.size(), "failed check #17");
+	for (size_t i = 0; i < b.circles.size(); i++){
+		test_assertion(address_of(b.circles[i]) == address_of(b.shapes[i].get()), "failed check #18");
+		test_assertion(b.circles[i]->radius == a.circles[i]->radius && b.shapes[i]->value == a.shapes[i]->value, "failed check #19");
+	}
+}
+
+void test19(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	const int n = 300;
+	Graph graph;
+	for (int i = 0; i < n; i++){
+		auto j = std::make_shared<Joined>();
+		j->value = rng();
+		j->extra = rng();
+		j->left = std::to_string(rng());
+		j->right = std::to_string(rng());
+		graph.joined.push_back(j);
+		graph.bases.push_back(j);
+		graph.lefts.push_back(j);
+		graph.rights.push_back(j);
+		graph.raw.push_back(j.get());
+
+		auto left = std::make_unique<Left>();
+		left->value = rng();
+		left->left = std::to_string(rng());
+		graph.owned_views.push_back(left.get());
+		graph.owned.push_back(std::move(left));
+
+		auto circle = std::make_shared<Circle>();
+		circle->value = rng();
+		circle->radius = (double)rng() / 7;
+		graph.shapes.push_back(circle);
+		graph.circles.push_back(circle.get());
+	}
+
+	SerializerStream::Options options;
+	options.include_offset_table = true;
+	auto serialized = serialize(graph, options);
+	DeserializerStream::Options doptions;
+	doptions.includes_offset_table = true;
+	for (unsigned threads : { 1, 4 }){
+		doptions.decoding_threads = threads;
+		DeserializerStream ds(serialized.data(), serialized.size());
+		auto graph2 = ds.full_deserialization<Graph>(doptions);
+		check(graph, *graph2);
+	}
+
+	//An std::unique_ptr and an std::shared_ptr to the same object.
+	{
+		Graph bad;
+		auto j = std::make_shared<Joined>();
+		bad.joined.push_back(j);
+		bad.owned.emplace_back(j.get());
+		auto serialized = serialize(bad, {});
+		bad.owned.front().release();
+		bool thrown = false;
+		try{
+			DeserializerStream ds(serialized.data(), serialized.size());
+			ds.full_deserialization<Graph>();
+		}catch (DeserializationException &e){
+			thrown = e.get_type() == DeserializerStream::ErrorType::InconsistentSmartPointers;
+		}
+		test_assertion(thrown, "failed check #20");
+	}
+}
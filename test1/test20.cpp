@@ -0,0 +1,61 @@
+#include "test2.generated.hpp"
+#include "util.hpp"
+#include <random>
+#include <iostream>
+
+using namespace test2_types;
+
+static void check(const Root &expected, const Root &root){
+	test_assertion(root.nodes.size() == expected.nodes.size(), "failed check #1");
+	for (size_t j = 0; j < root.nodes.size(); j++){
+		auto &a = *expected.nodes[j];
+		auto &b = *root.nodes[j];
+		test_assertion(a.data == b.data && a.links.size() == b.links.size(), "failed check #2");
+		for (size_t k = 0; k < b.links.size(); k++)
+			test_assertion(b.links[k]->data == a.links[k]->data, "failed check #3");
+	}
+}
+
+static void make_nodes(Root &root, size_t n){
+	for (size_t i = 0; i < n; i++){
+		root.nodes.push_back(std::make_unique<Node>());
+		root.nodes.back()->data = (std::uint32_t)i;
+	}
+	root.root = root.nodes.front().get();
+}
+
+static void add_links(Root &root, size_t links, std::mt19937 &rng){
+	for (auto &node : root.nodes)
+		for (size_t i = 0; i < links; i++)
+			node->links.push_back(root.nodes[rng() % root.nodes.size()].get());
+}
+
+//A graph with many pointers between its objects.
+void test20(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	Root root;
+	make_nodes(root, 2'000);
+	add_links(root, 16, rng);
+	check(root, *deserialize<Root>(serialize(root)));
+}
+
+//Measures what each pointer adds to the cost of deserializing a graph, by
+//comparing it to the same objects without the pointers.
+void benchmark20(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	const size_t n = 20'000;
+	const size_t links = 16;
+	Root root;
+	make_nodes(root, n);
+	auto without_pointers = serialize(root);
+	add_links(root, links, rng);
+	auto with_pointers = serialize(root);
+
+	DeserializerStream::Options options;
+	options.includes_typehashes = true;
+	auto links_time = time_deserialization<Root>(with_pointers, options, [&root](const Root &r){ check(root, r); });
+	for (auto &node : root.nodes)
+		node->links.clear();
+	auto base_time = time_deserialization<Root>(without_pointers, options, [&root](const Root &r){ check(root, r); });
+	std::cout << "Pointer deserialization time (avg): " << (links_time - base_time) / (n * links) * 1e9 << " ns\n";
+}
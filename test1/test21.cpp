@@ -0,0 +1,50 @@
+#include "test21.generated.hpp"
+#include "test21.generated.cpp"
+#include "util.hpp"
+#include <type_traits>
+
+using namespace test21_types;
+
+//M is a virtual base of everything that derives from it, because of the
+//diamond under P.
+template <typename Src, typename Dst>
+static constexpr bool is_virtual_cast = std::is_same_v<Dst, M> && !std::is_same_v<Src, M>;
+
+template <typename Src, typename Dst>
+static void check_cast(const SerializableMetadata &metadata){
+	Src src;
+	std::ptrdiff_t offset;
+	auto actual = metadata.categorize_cast(src.get_type_id(), Dst().get_type_id(), offset);
+	if constexpr (!std::is_base_of_v<Dst, Src>){
+		test_assertion(actual == CastCategory::Invalid, "failed check #1");
+	}else if constexpr (is_virtual_cast<Src, Dst>){
+		test_assertion(actual == CastCategory::Complex, "failed check #2");
+	}else{
+		test_assertion(actual == CastCategory::Trivial, "failed check #3");
+		auto expected = (char *)static_cast<Dst *>(&src) - (char *)&src;
+		test_assertion(offset == expected, "failed check #4");
+	}
+}
+
+//Non-virtual offsets are learned when the first Src is deserialized.
+template <typename Src, typename... Dsts>
+static void check_casts_from(const SerializableMetadata &metadata){
+	Src src;
+	round_trip(src);
+	(check_cast<Src, Dsts>(metadata), ...);
+}
+
+template <typename... Ts>
+static void check_all_casts(const SerializableMetadata &metadata){
+	(check_casts_from<Ts, Ts...>(metadata), ...);
+}
+
+//Checks the class hierarchy and offset tables against the C++ class hierarchy
+//for every pair of types.
+void test21(std::uint32_t){
+	auto metadata = A::static_get_metadata();
+	check_all_casts<A, B, C, D, E, F, G, H, K, M, N, O, P, Q>(*metadata);
+	std::ptrdiff_t offset;
+	test_assertion(metadata->categorize_cast(A().get_type_id(), 0, offset) == CastCategory::Invalid, "failed check #5");
+	test_assertion(metadata->categorize_cast(1000, A().get_type_id(), offset) == CastCategory::Invalid, "failed check #6");
+}
@@ -0,0 +1,37 @@
+#include "test2.generated.hpp"
+#include "util.hpp"
+#include <optional>
+
+using namespace test2_types;
+
+//The metadata is built once per generated file and isn't modified by the
+//streams that use it.
+void test22(std::uint32_t){
+	auto metadata = Root::static_get_metadata();
+	test_assertion(metadata == Root::static_get_metadata(), "failed check #1");
+	test_assertion(metadata == Node::static_get_metadata(), "failed check #2");
+	auto known_types = metadata->get_known_types();
+
+	Root root;
+	root.nodes.push_back(std::make_unique<Node>());
+	root.nodes.back()->data = 42;
+	root.root = root.nodes.back().get();
+	test_assertion(metadata == root.get_metadata(), "failed check #3");
+	auto serialized = serialize(root);
+	auto root2 = deserialize<Root>(serialized);
+	test_assertion(root2->root->data == 42, "failed check #4");
+	test_assertion(metadata->get_known_types() == known_types, "failed check #5");
+	for (auto &[id, hash] : known_types)
+		test_assertion(metadata->find_type_hash(id) && *metadata->find_type_hash(id) == hash, "failed check #6");
+
+	//A message that uses a type the receiver doesn't know. The type hashes
+	//start with their count and the ID of the first type, one byte each.
+	serialized[2] ^= 1;
+	std::optional<DeserializerStream::ErrorType> error;
+	try{
+		deserialize<Root>(serialized);
+	}catch (DeserializationException &e){
+		error = e.get_type();
+	}
+	test_assertion(error == DeserializerStream::ErrorType::AllocateObjectOfUnknownType, "failed check #7");
+}
@@ -0,0 +1,73 @@
+#include "test2.generated.hpp"
+#include "util.hpp"
+#include <random>
+
+using namespace test2_types;
+
+static std::unique_ptr<Root> make_graph(std::mt19937 &rng){
+	auto ret = std::make_unique<Root>();
+	auto n = rng() % 50 + 1;
+	for (unsigned i = 0; i < n; i++){
+		ret->nodes.push_back(std::make_unique<Node>());
+		ret->nodes.back()->data = rng();
+	}
+	for (auto &node : ret->nodes)
+		for (auto i = rng() % 4; i--;)
+			node->links.push_back(ret->nodes[rng() % n].get());
+	ret->root = ret->nodes[rng() % n].get();
+	return ret;
+}
+
+static bool equal(const Root &a, const Root &b){
+	if (a.nodes.size() != b.nodes.size() || a.root->data != b.root->data)
+		return false;
+	for (size_t i = 0; i < a.nodes.size(); i++){
+		auto &x = *a.nodes[i];
+		auto &y = *b.nodes[i];
+		if (x.data != y.data || x.links.size() != y.links.size())
+			return false;
+		for (size_t j = 0; j < x.links.size(); j++)
+			if (x.links[j]->data != y.links[j]->data)
+				return false;
+	}
+	return true;
+}
+
+//Decodes many messages at once, on several threads.
+void test23(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	const size_t n = 2000;
+	std::vector<std::unique_ptr<Root>> graphs;
+	std::vector<std::string> serialized;
+	std::vector<std::pair<const void *, size_t>> messages;
+	for (size_t i = 0; i < n; i++){
+		graphs.push_back(make_graph(rng));
+		serialized.push_back(serialize(*graphs.back()));
+	}
+	//Truncated, so it fails to decode.
+	serialized[n / 2].resize(serialized[n / 2].size() / 2);
+	for (auto &s : serialized)
+		messages.emplace_back(s.data(), s.size());
+
+	DeserializerStream::Options options;
+	options.includes_typehashes = true;
+	std::vector<std::exception_ptr> errors;
+	auto decoded = DeserializerStream::full_deserialization_batch<Root>(messages, options, 8, &errors);
+	test_assertion(decoded.size() == n && errors.size() == n, "failed check #1");
+	for (size_t i = 0; i < n; i++){
+		if (i == n / 2){
+			test_assertion(!decoded[i] && errors[i], "failed check #2");
+			continue;
+		}
+		test_assertion(decoded[i] && !errors[i], "failed check #3");
+		test_assertion(equal(*graphs[i], *decoded[i]), "failed check #4");
+	}
+
+	bool thrown = false;
+	try{
+		DeserializerStream::full_deserialization_batch<Root>(messages, options, 8);
+	}catch (DeserializationException &){
+		thrown = true;
+	}
+	test_assertion(thrown, "failed check #5");
+}
@@ -0,0 +1,90 @@
+#include "test5_client.generated.hpp"
+#include "test5_server.generated.hpp"
+#include "handler.hpp"
+#include "util.hpp"
+#include <negotiator.hpp>
+
+extern const std::string valid_filename;
+
+static std::string send(const Serializable &obj, const type_negotiation::Session &session){
+	std::string ret;
+	StringSink sink(ret);
+	SerializerStream ss(sink);
+	test_assertion(ss.full_serialization(obj, session.get_serializer_options()), "failed check #1");
+	return ret;
+}
+
+template <typename T>
+static std::unique_ptr<T> receive(const std::string &message, const type_negotiation::Session &session){
+	DeserializerStream ds(message.data(), message.size());
+	return ds.full_deserialization<T>(session.get_deserializer_options());
+}
+
+//test5 over a session: the type hashes are exchanged once, and the requests
+//and responses only carry protocol type IDs.
+void test24(std::uint32_t){
+	client::requests::GetFileSize request;
+	request.name = valid_filename;
+	server::responses::Void server_object;
+
+	std::string first_message, reply;
+	{
+		StringSink sink(first_message);
+		SerializerStream ss(sink);
+		test_assertion(type_negotiation::send_first_message(ss, request), "failed check #2");
+	}
+	std::optional<type_negotiation::Session> server_session;
+	{
+		DeserializerStream ds(first_message.data(), first_message.size());
+		StringSink sink(reply);
+		SerializerStream ss(sink);
+		server_session = type_negotiation::accept_session(ds, ss, server_object);
+		test_assertion(server_session.has_value(), "failed check #3");
+	}
+	DeserializerStream ds(reply.data(), reply.size());
+	auto client_session = type_negotiation::connect_session(ds);
+	test_assertion(client_session.has_value(), "failed check #7");
+
+	RequestHandler handler;
+	for (int i = 0; i < 3; i++){
+		auto serialized = send(request, *client_session);
+		test_assertion(serialized.size() * 3 < serialize(request).size(), "failed check #4");
+		auto request2 = receive<server::requests::Request>(serialized, *server_session);
+		test_assertion(!!request2, "failed check #5");
+		auto response = request2->handle(handler);
+		auto response2 = receive<client::responses::Response>(send(*response, *server_session), *client_session);
+		test_assertion(response2 && response2->to_string() == "42", "failed check #6");
+	}
+
+	//Options taken from a session stay valid when it's moved.
+	{
+		auto options = server_session->get_deserializer_options();
+		auto moved = std::move(*server_session);
+		server_session.reset();
+		auto serialized = send(request, *client_session);
+		DeserializerStream ds(serialized.data(), serialized.size());
+		auto request2 = ds.full_deserialization<server::requests::Request>(options);
+		auto get_file_size = dynamic_cast<server::requests::GetFileSize *>(request2.get());
+		test_assertion(get_file_size && get_file_size->name == valid_filename, "failed check #10");
+	}
+
+	//Both ends learn that the handshake failed when there are no types in
+	//common.
+	{
+		std::string empty_message, empty_reply;
+		{
+			StringSink sink(empty_message);
+			SerializerStream ss(sink);
+			ss.serialize(wire_flags::all);
+			ss.serialize((std::uint32_t)0);
+		}
+		{
+			DeserializerStream ds(empty_message.data(), empty_message.size());
+			StringSink sink(empty_reply);
+			SerializerStream ss(sink);
+			test_assertion(!type_negotiation::accept_session(ds, ss, server_object), "failed check #8");
+		}
+		DeserializerStream ds(empty_reply.data(), empty_reply.size());
+		test_assertion(!type_negotiation::connect_session(ds), "failed check #9");
+	}
+}
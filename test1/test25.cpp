@@ -0,0 +1,111 @@
+#include "test10.generated.hpp"
+#include "util.hpp"
+#include <random>
+#include <optional>
+#include <algorithm>
+
+using namespace test10_types;
+
+//A graph that grows over several messages of a session. Every message sends a
+//new Graph that points to all the nodes so far, but only the new nodes are
+//sent.
+void test25(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	const int rounds = 5;
+	const int nodes_per_round = 20;
+	std::vector<std::unique_ptr<Node>> storage;
+	std::vector<std::shared_ptr<Leaf>> leaves;
+	std::vector<std::unique_ptr<Graph>> graphs;
+
+	SerializerStream::Options options;
+	options.include_typehashes = true;
+	options.include_offset_table = true;
+	options.traversal_threads = 2;
+	std::string stream;
+	std::vector<size_t> message_sizes;
+	{
+		StringSink sink(stream);
+		SerializerStream ss(sink);
+		ss.begin_session();
+		for (int round = 0; round < rounds; round++){
+			for (int i = 0; i < 2; i++){
+				leaves.push_back(std::make_shared<Leaf>());
+				leaves.back()->name = std::to_string(rng());
+				leaves.back()->weight = (double)rng() / 7;
+			}
+			for (int i = 0; i < nodes_per_round; i++){
+				storage.push_back(std::make_unique<Node>());
+				auto &node = *storage.back();
+				node.value = rng();
+				node.next = storage[rng() % storage.size()].get();
+				node.leaf = leaves[rng() % leaves.size()];
+			}
+			graphs.push_back(std::make_unique<Graph>());
+			for (auto &node : storage)
+				graphs.back()->nodes.push_back(node.get());
+			graphs.back()->leaves = leaves;
+
+			auto before = sink.size();
+			//Must not make the session forget to send anything.
+			auto expected_size = ss.compute_serialized_size(*graphs.back(), options);
+			test_assertion(ss.full_serialization(*graphs.back(), options), "failed check #1");
+			message_sizes.push_back(sink.size() - before);
+			test_assertion(expected_size && *expected_size == message_sizes.back(), "failed check #2");
+			if (round){
+				std::string standalone;
+				StringSink sink2(standalone);
+				auto standalone_size = SerializerStream(sink2).compute_serialized_size(*graphs.back(), options);
+				//Standalone messages grow with the graph; these don't, apart from
+				//the node list of the new Graph.
+				test_assertion(message_sizes.back() * (round + 1) < *standalone_size * 2, "failed check #3");
+			}
+		}
+		//Nothing new.
+		auto before = sink.size();
+		test_assertion(ss.full_serialization(*graphs.back(), options), "failed check #4");
+		message_sizes.push_back(sink.size() - before);
+		test_assertion(message_sizes.back() < 16, "failed check #5");
+	}
+
+	for (unsigned threads : { 1, 4 }){
+		DeserializerStream::Options doptions;
+		doptions.includes_typehashes = true;
+		doptions.includes_offset_table = true;
+		doptions.decoding_threads = threads;
+		Node::destroyed = 0;
+		{
+			DeserializerStream ds(stream.data(), stream.size());
+			std::vector<Graph *> received;
+			for (int round = 0; round < rounds; round++){
+				auto graph2 = ds.full_deserialization_session<Graph>(doptions);
+				test_assertion(!!graph2, "failed check #6");
+				auto &graph = *graphs[round];
+				test_assertion(graph2->nodes.size() == graph.nodes.size() && graph2->leaves.size() == graph.leaves.size(), "failed check #7");
+				for (size_t i = 0; i < graph.nodes.size(); i++){
+					auto &a = *graph.nodes[i];
+					auto &b = *graph2->nodes[i];
+					auto next = std::find(graph.nodes.begin(), graph.nodes.end(), a.next) - graph.nodes.begin();
+					test_assertion(a.value == b.value && b.next == graph2->nodes[next], "failed check #8");
+					test_assertion(b.leaf->name == a.leaf->name, "failed check #9");
+					//Objects from earlier messages are reused, not sent again.
+					if (round && i < received.back()->nodes.size())
+						test_assertion(graph2->nodes[i] == received.back()->nodes[i], "failed check #10");
+				}
+				for (size_t i = 0; round && i < received.back()->leaves.size(); i++)
+					test_assertion(graph2->leaves[i] == received.back()->leaves[i], "failed check #11");
+				received.push_back(graph2);
+			}
+			test_assertion(ds.full_deserialization_session<Graph>(doptions) == received.back(), "failed check #12");
+			test_assertion(Node::destroyed == 0, "failed check #13");
+
+			std::optional<DeserializerStream::ErrorType> error;
+			try{
+				ds.full_deserialization<Graph>(doptions);
+			}catch (DeserializationException &e){
+				error = e.get_type();
+			}
+			test_assertion(error == DeserializerStream::ErrorType::InvalidProgramState, "failed check #14");
+		}
+		test_assertion(Node::destroyed == rounds * nodes_per_round, "failed check #15");
+	}
+}
@@ -0,0 +1,105 @@
+#include "test1.generated.hpp"
+#include "test2.generated.hpp"
+#include "util.hpp"
+#include <random>
+#include <iostream>
+#include <limits>
+
+void gen(test1_types::A &dst, std::mt19937 &rng);
+
+static void test_codec(){
+	std::vector<std::uint64_t> values = { 0, std::numeric_limits<std::uint64_t>::max() };
+	for (unsigned bits = 1; bits < 64; bits++){
+		values.push_back(((std::uint64_t)1 << bits) - 1);
+		values.push_back((std::uint64_t)1 << bits);
+	}
+	for (auto n : values){
+		unsigned expected_length = 1;
+		while (expected_length < 8 && n >> (7 * expected_length))
+			expected_length++;
+		if (expected_length == 8 && n >> 56)
+			expected_length = prefix_varint::max_length;
+		std::uint8_t buffer[prefix_varint::max_length * 2] = {};
+		auto length = prefix_varint::encode(buffer, n);
+		test_assertion(length == expected_length && length == prefix_varint::encoded_length(n), "failed check #2");
+		test_assertion(prefix_varint::length_from_first_byte(buffer[0]) == length, "failed check #3");
+		//Whatever follows the number doesn't matter.
+		memset(buffer + length, 0xFF, sizeof(buffer) - length);
+		unsigned decoded_length;
+		test_assertion(prefix_varint::decode_fast(buffer, decoded_length) == n && decoded_length == length, "failed check #4");
+		test_assertion(prefix_varint::decode(buffer, length) == n, "failed check #5");
+	}
+}
+
+static void check(const test2_types::Root &expected, const test2_types::Root &root){
+	test_assertion(root.nodes.size() == expected.nodes.size(), "failed check #6");
+	for (size_t j = 0; j < root.nodes.size(); j++){
+		auto &a = *expected.nodes[j];
+		auto &b = *root.nodes[j];
+		test_assertion(a.data == b.data && a.links.size() == b.links.size(), "failed check #7");
+	}
+}
+
+static void make_graph(test2_types::Root &root, size_t n, std::mt19937 &rng){
+	using namespace test2_types;
+	for (size_t i = 0; i < n; i++){
+		root.nodes.push_back(std::make_unique<Node>());
+		root.nodes.back()->data = rng();
+	}
+	root.root = root.nodes.front().get();
+	for (auto &node : root.nodes)
+		for (size_t i = 0; i < 16; i++)
+			node->links.push_back(root.nodes[rng() % n].get());
+}
+
+//Prefix-length varints.
+void test26(std::uint32_t seed){
+	test_codec();
+
+	std::mt19937 rng(seed);
+	SerializerStream::Options options;
+	options.include_typehashes = true;
+	options.wire_format = wire_flags::prefix_varints;
+	DeserializerStream::Options doptions;
+	doptions.includes_typehashes = true;
+	doptions.wire_format = wire_flags::prefix_varints;
+	for (int i = 0; i < 1000; i++){
+		test1_types::A a;
+		gen(a, rng);
+		auto serialized = serialize(a, options);
+		test_assertion(*deserialize<test1_types::A>(serialized, doptions) == a, "failed check #8");
+		//Every prefix is too short.
+		for (size_t size = serialized.size() - 16; size < serialized.size(); size++){
+			bool thrown = false;
+			try{
+				deserialize<test1_types::A>(serialized.substr(0, size), doptions);
+			}catch (DeserializationException &){
+				thrown = true;
+			}
+			test_assertion(thrown, "failed check #9");
+		}
+	}
+
+	//A prefix varint is never longer than the original varint.
+	test2_types::Root root;
+	make_graph(root, 2'000, rng);
+	auto original_options = options;
+	original_options.wire_format = 0;
+	auto original = serialize(root, original_options);
+	auto prefixed = serialize(root, options);
+	test_assertion(prefixed.size() <= original.size(), "failed check #10");
+	check(root, *deserialize<test2_types::Root>(prefixed, doptions));
+}
+
+void benchmark26(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	test2_types::Root root;
+	make_graph(root, 20'000, rng);
+	SerializerStream::Options options;
+	DeserializerStream::Options doptions;
+	options.wire_format = doptions.wire_format = wire_flags::prefix_varints;
+	auto check_root = [&root](const test2_types::Root &r){ check(root, r); };
+	auto original_time = time_deserialization<test2_types::Root>(serialize(root, {}), {}, check_root);
+	auto prefix_time = time_deserialization<test2_types::Root>(serialize(root, options), doptions, check_root);
+	std::cout << "Prefix varint deserialization speedup: " << original_time / prefix_time << "x\n";
+}
@@ -0,0 +1,145 @@
+#include "test27.generated.hpp"
+#include "test27.generated.cpp"
+#include "util.hpp"
+#include <random>
+#include <iostream>
+#include <limits>
+
+using namespace test27_types;
+
+template <typename T>
+static void gen_values(std::vector<T> &dst, size_t n, std::mt19937 &rng){
+	dst.resize(n);
+	for (auto &x : dst){
+		//Values of every length.
+		auto bits = rng() % (sizeof(T) * 8) + 1;
+		std::uint64_t u = ((std::uint64_t)rng() << 32 | rng()) >> (64 - bits);
+		x = (T)u;
+	}
+}
+
+template <typename T>
+static void test_codec(std::mt19937 &rng){
+	for (size_t n = 0; n < 70; n++){
+		std::vector<T> values;
+		gen_values(values, n, rng);
+		std::vector<std::uint8_t> buffer(block_codec::max_encoded_size<T>(n));
+		auto size = block_codec::encode(values.data(), n, buffer.data());
+		test_assertion(size == block_codec::encoded_size(values.data(), n), "failed check #3");
+		auto control_size = block_codec::control_size<T>(n);
+		auto data_size = block_codec::data_size<T>(buffer.data(), n);
+		test_assertion(control_size + data_size == size, "failed check #4");
+		//Exactly the size of the data, so reading past it would be caught by
+		//sanitizers.
+		std::vector<std::uint8_t> data(buffer.begin() + control_size, buffer.begin() + size);
+		std::vector<T> decoded(n);
+		block_codec::decode(buffer.data(), data.data(), data_size, n, decoded.data());
+		test_assertion(decoded == values, "failed check #5");
+	}
+}
+
+static bool operator==(const Arrays &a, const Arrays &b){
+	return a.a == b.a && a.b == b.b && a.c == b.c && a.d == b.d && a.e == b.e && a.f == b.f && a.g == b.g && a.samples == b.samples;
+}
+
+//A long series of sensor readings.
+static void make_samples(Arrays &arrays, std::mt19937 &rng){
+	arrays.samples.resize(1'000'000);
+	for (auto &x : arrays.samples)
+		x = rng() % (1 << 20);
+}
+
+//Block-coded integer vectors and strings.
+void test27(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	test_codec<std::uint16_t>(rng);
+	test_codec<std::uint32_t>(rng);
+	test_codec<std::uint64_t>(rng);
+	test_codec<std::int16_t>(rng);
+	test_codec<std::int32_t>(rng);
+	test_codec<std::int64_t>(rng);
+
+	for (std::uint32_t flags : { wire_flags::block_integers, wire_flags::block_integers | wire_flags::prefix_varints }){
+		SerializerStream::Options options;
+		options.include_typehashes = true;
+		options.wire_format = flags;
+		DeserializerStream::Options doptions;
+		doptions.includes_typehashes = true;
+		doptions.wire_format = flags;
+		for (int i = 0; i < 200; i++){
+			Arrays arrays;
+			gen_values(arrays.a, rng() % 50, rng);
+			gen_values(arrays.b, rng() % 50, rng);
+			gen_values(arrays.c, rng() % 50, rng);
+			gen_values(arrays.d, rng() % 50, rng);
+			gen_values(arrays.e, rng() % 50, rng);
+			gen_values(arrays.f, rng() % 50, rng);
+			std::vector<std::uint32_t> chars;
+			gen_values(chars, rng() % 50, rng);
+			for (auto c : chars)
+				arrays.g.push_back((char32_t)c);
+			auto serialized = serialize(arrays, options);
+			{
+				DeserializerStream ds(serialized.data(), serialized.size());
+				auto arrays2 = ds.full_deserialization<Arrays>(doptions);
+				test_assertion(arrays2 && *arrays2 == arrays, "failed check #7");
+			}
+			bool thrown = false;
+			try{
+				DeserializerStream ds(serialized.data(), serialized.size() - 1);
+				ds.full_deserialization<Arrays>(doptions);
+			}catch (DeserializationException &){
+				thrown = true;
+			}
+			test_assertion(thrown, "failed check #8");
+		}
+	}
+
+	//A huge length followed by a few bytes fails at the end of the input
+	//instead of allocating the whole vector up front.
+	{
+		std::string hostile;
+		{
+			StringSink sink(hostile);
+			SerializerStream ss(sink);
+			std::uint8_t padding[16] = {};
+			ss.serialize((wire_size_t)1 << 40);
+			ss.serialize_array(padding);
+		}
+		auto check = [&hostile](auto v){
+			bool thrown = false;
+			try{
+				DeserializerStream ds(hostile.data(), hostile.size());
+				ds.deserialize(v);
+			}catch (DeserializationException &e){
+				thrown = e.get_type() == DeserializerStream::ErrorType::UnexpectedEndOfFile;
+			}
+			test_assertion(thrown, "failed check #9");
+		};
+		check(std::vector<std::uint32_t>());
+		check(std::vector<double>());
+	}
+
+	//Much larger than the sink's window, so it's encoded through the scratch
+	//buffer.
+	Arrays arrays;
+	make_samples(arrays, rng);
+	SerializerStream::Options options;
+	DeserializerStream::Options doptions;
+	options.wire_format = doptions.wire_format = wire_flags::block_integers;
+	auto arrays2 = deserialize<Arrays>(serialize(arrays, options), doptions);
+	test_assertion(arrays2 && arrays2->samples == arrays.samples, "failed check #6");
+}
+
+void benchmark27(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	Arrays arrays;
+	make_samples(arrays, rng);
+	auto check = [&arrays](const Arrays &a){ test_assertion(a.samples == arrays.samples, "failed check #6"); };
+	auto original_time = time_deserialization<Arrays>(serialize(arrays, {}), {}, check);
+	SerializerStream::Options options;
+	DeserializerStream::Options doptions;
+	options.wire_format = doptions.wire_format = wire_flags::block_integers;
+	auto block_time = time_deserialization<Arrays>(serialize(arrays, options), doptions, check);
+	std::cout << "Block codec deserialization speedup: " << original_time / block_time << "x\n";
+}
@@ -0,0 +1,114 @@
+#include "test28.generated.hpp"
+#include "test28.generated.cpp"
+#include "util.hpp"
+#include <random>
+#include <iostream>
+#include <limits>
+
+using namespace test28_types;
+
+static std::string serialize_geometry(const Serializable &src){
+	SerializerStream::Options options;
+	options.include_typehashes = true;
+	return serialize(src, options);
+}
+
+template <typename T>
+static bool bitwise_equal(const T &a, const T &b){
+	return a.size() == b.size() && !memcmp(a.data(), b.data(), a.size() * sizeof(a[0]));
+}
+
+static bool operator==(const Geometry &a, const Geometry &b){
+	return
+		bitwise_equal(a.points, b.points) &&
+		bitwise_equal(a.weights, b.weights) &&
+		bitwise_equal(a.transform, b.transform) &&
+		bitwise_equal(a.origin, b.origin) &&
+		bitwise_equal(a.samples, b.samples);
+}
+
+template <typename T>
+static T random_float(std::mt19937 &rng){
+	static const T special[] = {
+		0,
+		-(T)0,
+		std::numeric_limits<T>::infinity(),
+		-std::numeric_limits<T>::infinity(),
+		std::numeric_limits<T>::quiet_NaN(),
+		std::numeric_limits<T>::denorm_min(),
+		std::numeric_limits<T>::max(),
+		std::numeric_limits<T>::lowest(),
+	};
+	if (rng() % 4 == 0)
+		return special[rng() % (sizeof(special) / sizeof(*special))];
+	return (T)rng() / (T)rng() * (rng() % 2 ? 1 : -1);
+}
+
+//Same values, serialized one by one, as the generic path would.
+template <typename T>
+static std::string serialize_one_by_one(const T *p, size_t n){
+	std::string ret;
+	StringSink sink(ret);
+	SerializerStream ss(sink);
+	for (size_t i = 0; i < n; i++)
+		ss.serialize(p[i]);
+	sink.flush();
+	return ret;
+}
+
+template <typename T>
+static std::string serialize_bulk(const T *p, size_t n){
+	std::string ret;
+	StringSink sink(ret);
+	SerializerStream ss(sink);
+	ss.serialize_floats(p, n);
+	sink.flush();
+	return ret;
+}
+
+//Bulk copies of float and double vectors and arrays.
+void test28(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	for (int i = 0; i < 200; i++){
+		Geometry geometry;
+		geometry.points.resize(rng() % 100);
+		for (auto &x : geometry.points)
+			x = random_float<double>(rng);
+		geometry.weights.resize(rng() % 100);
+		for (auto &x : geometry.weights)
+			x = random_float<float>(rng);
+		for (auto &x : geometry.transform)
+			x = random_float<float>(rng);
+		for (auto &x : geometry.origin)
+			x = random_float<double>(rng);
+		//The wire format doesn't change.
+		test_assertion(serialize_bulk(geometry.points.data(), geometry.points.size()) == serialize_one_by_one(geometry.points.data(), geometry.points.size()), "failed check #4");
+		test_assertion(serialize_bulk(geometry.transform.data(), geometry.transform.size()) == serialize_one_by_one(geometry.transform.data(), geometry.transform.size()), "failed check #5");
+
+		auto serialized = serialize_geometry(geometry);
+		auto geometry2 = deserialize<Geometry>(serialized);
+		test_assertion(geometry2 && *geometry2 == geometry, "failed check #6");
+		bool thrown = false;
+		try{
+			deserialize<Geometry>(serialized.substr(0, serialized.size() - 1));
+		}catch (DeserializationException &){
+			thrown = true;
+		}
+		test_assertion(thrown, "failed check #7");
+	}
+}
+
+void benchmark28(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	Geometry geometry;
+	geometry.samples.resize(4'000'000);
+	for (auto &x : geometry.samples)
+		x = random_float<double>(rng);
+	auto serialized = serialize_geometry(geometry);
+	DeserializerStream::Options options;
+	options.includes_typehashes = true;
+	auto t = time_deserialization<Geometry>(serialized, options, [&geometry](const Geometry &g){
+		test_assertion(bitwise_equal(g.samples, geometry.samples), "failed check #3");
+	});
+	std::cout << "Bulk double deserialization: " << serialized.size() / t / 1e9 << " GB/s\n";
+}
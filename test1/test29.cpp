@@ -0,0 +1,134 @@
+#include "test29.generated.hpp"
+#include "test29.generated.cpp"
+#include "util.hpp"
+#include <random>
+#include <iostream>
+#include <limits>
+#include <optional>
+
+using namespace test29_types;
+
+static std::string serialize_telemetry(const Telemetry &src){
+	std::string ret;
+	StringSink sink(ret);
+	SerializerStream ss(sink);
+	SerializerStream::Options options;
+	options.include_typehashes = true;
+	auto size = ss.compute_serialized_size(src, options);
+	test_assertion(ss.full_serialization(src, options), "failed check #1");
+	sink.flush();
+	test_assertion(size && *size == ret.size(), "failed check #2");
+	return ret;
+}
+
+static std::unique_ptr<Telemetry> deserialize_telemetry(const std::string &src){
+	DeserializerStream ds(src.data(), src.size());
+	DeserializerStream::Options options;
+	options.includes_typehashes = true;
+	return ds.full_deserialization<Telemetry>(options);
+}
+
+static bool bitwise_equal(const std::vector<double> &a, const std::vector<double> &b){
+	return a.size() == b.size() && !memcmp(a.data(), b.data(), a.size() * sizeof(double));
+}
+
+static bool operator==(const Telemetry &a, const Telemetry &b){
+	return
+		a.id == b.id &&
+		bitwise_equal(a.temperature, b.temperature) &&
+		bitwise_equal(a.raw, b.raw) &&
+		bitwise_equal(a.pressure, b.pressure);
+}
+
+//Readings with one decimal that drift slowly, with repeats.
+static void gen_series(std::vector<double> &dst, size_t n, double start, std::mt19937 &rng){
+	dst.resize(n);
+	int tenths = (int)(start * 10);
+	for (auto &x : dst){
+		auto r = rng() % 8;
+		if (r == 0)
+			tenths++;
+		else if (r == 1)
+			tenths--;
+		x = tenths / 10.0;
+	}
+}
+
+static void gen_special(std::vector<double> &dst, size_t n, std::mt19937 &rng){
+	static const double special[] = {
+		0,
+		-0.0,
+		1,
+		std::numeric_limits<double>::infinity(),
+		-std::numeric_limits<double>::infinity(),
+		std::numeric_limits<double>::quiet_NaN(),
+		std::numeric_limits<double>::denorm_min(),
+		std::numeric_limits<double>::max(),
+	};
+	dst.resize(n);
+	for (auto &x : dst){
+		if (rng() % 2)
+			x = special[rng() % (sizeof(special) / sizeof(*special))];
+		else{
+			auto bits = (std::uint64_t)rng() << 32 | rng();
+			memcpy(&x, &bits, sizeof(x));
+		}
+	}
+}
+
+static void test_codec(const std::vector<double> &values){
+	auto size = gorilla::encoded_size(values.data(), values.size());
+	test_assertion(size <= gorilla::max_encoded_size(values.size()), "failed check #11");
+	std::vector<std::uint8_t> buffer(size);
+	test_assertion(gorilla::encode(values.data(), values.size(), buffer.data()) == size, "failed check #3");
+	std::vector<double> decoded(values.size());
+	test_assertion(gorilla::decode(buffer.data(), buffer.size(), decoded.size(), decoded.data()), "failed check #4");
+	test_assertion(bitwise_equal(decoded, values), "failed check #5");
+	if (size){
+		test_assertion(!gorilla::decode(buffer.data(), buffer.size() - 1, decoded.size(), decoded.data()), "failed check #6");
+		buffer.push_back(0);
+		test_assertion(!gorilla::decode(buffer.data(), buffer.size(), decoded.size(), decoded.data()), "failed check #7");
+	}
+}
+
+//XOR-coded vector<double> members.
+void test29(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	for (size_t n = 0; n < 100; n++){
+		std::vector<double> values;
+		gen_series(values, n, 20, rng);
+		test_codec(values);
+		gen_special(values, n, rng);
+		test_codec(values);
+	}
+
+	for (int i = 0; i < 200; i++){
+		Telemetry telemetry;
+		telemetry.id = rng();
+		gen_series(telemetry.temperature, rng() % 100, 20, rng);
+		gen_special(telemetry.raw, rng() % 100, rng);
+		gen_special(telemetry.pressure, rng() % 100, rng);
+		auto serialized = serialize_telemetry(telemetry);
+		auto telemetry2 = deserialize_telemetry(serialized);
+		test_assertion(telemetry2 && *telemetry2 == telemetry, "failed check #8");
+		std::optional<DeserializerStream::ErrorType> error;
+		try{
+			deserialize_telemetry(serialized.substr(0, serialized.size() - 1));
+		}catch (DeserializationException &e){
+			error = e.get_type();
+		}
+		test_assertion(error.has_value(), "failed check #9");
+	}
+
+	Telemetry telemetry;
+	gen_series(telemetry.temperature, 100'000, 20, rng);
+	gen_series(telemetry.pressure, 100'000, 1013, rng);
+	telemetry.raw = telemetry.temperature;
+	std::string serialized;
+	StringSink sink(serialized);
+	SerializerStream ss(sink);
+	auto raw_size = ss.serialized_size(telemetry.raw);
+	auto gorilla_size = ss.serialized_size_gorilla(telemetry.temperature);
+	test_assertion(gorilla_size < raw_size, "failed check #10");
+	std::cout << "Gorilla codec size reduction: " << (double)raw_size / gorilla_size << "x\n";
+}
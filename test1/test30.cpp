@@ -0,0 +1,125 @@
+#include "test30.generated.hpp"
+#include "test30.generated.cpp"
+#include "util.hpp"
+#include <random>
+#include <iostream>
+#include <limits>
+
+using namespace test30_types;
+
+static bool operator==(const Index &a, const Index &b){
+	return
+		a.ids == b.ids &&
+		a.offsets == b.offsets &&
+		a.flags == b.flags &&
+		a.wide == b.wide &&
+		a.names == b.names &&
+		a.counts == b.counts &&
+		a.words == b.words;
+}
+
+template <typename T>
+static T random_key(std::mt19937 &rng){
+	switch (rng() % 4){
+		case 0:
+			return std::numeric_limits<T>::min();
+		case 1:
+			return std::numeric_limits<T>::max();
+		default:
+			return (T)((std::uint64_t)rng() << 32 | rng());
+	}
+}
+
+template <typename T>
+static void test_gaps(std::mt19937 &rng){
+	for (int i = 0; i < 1000; i++){
+		auto a = random_key<T>(rng);
+		auto b = random_key<T>(rng);
+		if (a == b)
+			continue;
+		if (b < a)
+			std::swap(a, b);
+		T c;
+		test_assertion(ordered_key_after(a, ordered_key_gap(a, b), c) && c == b, "failed check #3");
+	}
+	T c;
+	test_assertion(!ordered_key_after(std::numeric_limits<T>::max(), (typename std::make_unsigned<T>::type)0, c), "failed check #4");
+	test_assertion(!ordered_key_after((T)(std::numeric_limits<T>::max() - 1), (typename std::make_unsigned<T>::type)1, c), "failed check #5");
+}
+
+//A large set of IDs, close together.
+static void make_ids(Index &index, std::mt19937 &rng){
+	std::uint32_t id = 1'000'000'000;
+	for (int i = 0; i < 1'000'000; i++){
+		id += rng() % 16 + 1;
+		index.ids.insert(index.ids.end(), id);
+	}
+}
+
+//Delta-coded keys of sets and maps.
+void test30(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	test_gaps<std::uint8_t>(rng);
+	test_gaps<std::int16_t>(rng);
+	test_gaps<std::uint32_t>(rng);
+	test_gaps<std::int64_t>(rng);
+	test_gaps<std::uint64_t>(rng);
+
+	for (std::uint32_t flags : { 0U, wire_flags::sorted_key_deltas, wire_flags::sorted_key_deltas | wire_flags::prefix_varints }){
+		SerializerStream::Options options;
+		options.include_typehashes = true;
+		options.wire_format = flags;
+		DeserializerStream::Options doptions;
+		doptions.includes_typehashes = true;
+		doptions.wire_format = flags;
+		for (int i = 0; i < 200; i++){
+			Index index;
+			for (auto n = rng() % 50; n--;){
+				index.ids.insert(random_key<std::uint32_t>(rng));
+				index.offsets.insert(random_key<std::int16_t>(rng));
+				index.flags.insert(random_key<std::uint8_t>(rng));
+				index.wide.insert(random_key<std::int64_t>(rng));
+				index.names[random_key<std::uint64_t>(rng)] = std::to_string(rng());
+				index.counts[random_key<std::int32_t>(rng)] = rng();
+				index.words.insert(std::to_string(rng() % 1000));
+			}
+			auto serialized = serialize(index, options);
+			auto index2 = deserialize<Index>(serialized, doptions);
+			test_assertion(index2 && *index2 == index, "failed check #7");
+			bool thrown = false;
+			try{
+				deserialize<Index>(serialized.substr(0, serialized.size() - 1), doptions);
+			}catch (DeserializationException &){
+				thrown = true;
+			}
+			test_assertion(thrown, "failed check #8");
+		}
+	}
+
+	//Gaps of at most 16 take one byte, where the IDs themselves take five.
+	Index index;
+	make_ids(index, rng);
+	SerializerStream::Options options;
+	DeserializerStream::Options doptions;
+	options.wire_format = doptions.wire_format = wire_flags::sorted_key_deltas;
+	auto plain = serialize(index, {});
+	auto deltas = serialize(index, options);
+	test_assertion(deltas.size() * 4 < plain.size(), "failed check #1");
+	auto index2 = deserialize<Index>(deltas, doptions);
+	test_assertion(index2 && index2->ids == index.ids, "failed check #2");
+}
+
+void benchmark30(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	Index index;
+	make_ids(index, rng);
+	SerializerStream::Options options;
+	DeserializerStream::Options doptions;
+	options.wire_format = doptions.wire_format = wire_flags::sorted_key_deltas;
+	auto plain = serialize(index, {});
+	auto deltas = serialize(index, options);
+	auto check = [&index](const Index &i){ test_assertion(i.ids == index.ids, "failed check #6"); };
+	auto plain_time = time_deserialization<Index>(plain, {}, check);
+	auto deltas_time = time_deserialization<Index>(deltas, doptions, check);
+	std::cout << "Sorted key delta deserialization speedup: " << plain_time / deltas_time << "x\n";
+}
@@ -22,8 +22,9 @@ std::unique_ptr<Response> RequestHandler::handle(const server::requests::GetFile
 		ret->error = "file not found";
 		return ret;
 	}
+	static const std::uint8_t contents[42] = {};
 	auto ret = std::make_unique<server::responses::FileContents>();
-	ret->contents.resize(42);
+	ret->contents = buffer_view<std::uint8_t>(contents, sizeof(contents), nullptr);
 	return ret;
 }
 
@@ -0,0 +1,63 @@
+#include "test1.generated.hpp"
+#include "gen.hpp"
+#include "util.hpp"
+
+using namespace test1_types;
+
+void gen(A &dst, std::mt19937 &rng);
+
+void test8(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	A a;
+	gen(a, rng);
+
+	std::stringstream stream;
+	{
+		SerializerStream ss(stream);
+		ss.full_serialization(a, true);
+	}
+	auto expected = stream.str();
+
+	{
+		std::string s = "prefix";
+		StringSink sink(s);
+		SerializerStream ss(sink);
+		ss.full_serialization(a, true);
+		test_assertion(s.size() == expected.size() + 6, "failed check #1");
+		test_assertion(s.substr(6) == expected, "failed check #2");
+	}
+	{
+		std::vector<char> v;
+		VectorSink sink(v);
+		SerializerStream ss(sink);
+		ss.full_serialization(a, true);
+		test_assertion(std::string(v.begin(), v.end()) == expected, "failed check #3");
+	}
+	{
+		std::vector<char> buffer(expected.size());
+		FixedBufferSink sink(buffer.data(), buffer.size());
+		SerializerStream ss(sink);
+		ss.full_serialization(a, true);
+		test_assertion(sink.size() == expected.size(), "failed check #4");
+		test_assertion(std::string(buffer.begin(), buffer.end()) == expected, "failed check #5");
+	}
+	{
+		std::vector<char> buffer(expected.size() - 1);
+		FixedBufferSink sink(buffer.data(), buffer.size());
+		SerializerStream ss(sink);
+		bool thrown = false;
+		try{
+			ss.full_serialization(a, true);
+		}catch (SinkOverflowException &){
+			thrown = true;
+		}
+		test_assertion(thrown, "failed check #6");
+	}
+	{
+		std::stringstream stream2;
+		OstreamSink sink(stream2, 64);
+		SerializerStream ss(sink);
+		ss.full_serialization(a, true);
+		test_assertion(stream2.str() == expected, "failed check #7");
+	}
+}
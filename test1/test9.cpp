@@ -0,0 +1,108 @@
+#include "test1.generated.hpp"
+#include "gen.hpp"
+#include "util.hpp"
+#include <optional>
+
+using namespace test1_types;
+
+void gen(A &dst, std::mt19937 &rng);
+
+namespace{
+
+//Like a pipe: the data can only be read once.
+class UnseekableBuffer : public std::streambuf{
+	std::string data;
+public:
+	UnseekableBuffer(std::string data): data(std::move(data)){
+		this->setg(&this->data[0], &this->data[0], &this->data[0] + this->data.size());
+	}
+};
+
+}
+
+void test9(std::uint32_t seed){
+	std::mt19937 rng(seed);
+	A a, b;
+	gen(a, rng);
+	gen(b, rng);
+	auto serialized_a = serialize(a);
+	auto serialized_b = serialize(b);
+
+	{
+		MemorySource source(serialized_a.data(), serialized_a.size());
+		DeserializerStream ds(source);
+		auto a2 = ds.full_deserialization<A>(true);
+		test_assertion(a == *a2, "failed check #1");
+		test_assertion(source.position() == serialized_a.size(), "failed check #2");
+	}
+	{
+		//Two messages back to back, read with a buffer much smaller than
+		//either of them.
+		std::stringstream stream(serialized_a + serialized_b);
+		{
+			IstreamSource source(stream, 64);
+			DeserializerStream ds(source);
+			auto a2 = ds.full_deserialization<A>(true);
+			test_assertion(a == *a2, "failed check #3");
+		}
+		{
+			DeserializerStream ds(stream);
+			auto b2 = ds.full_deserialization<A>(true);
+			test_assertion(b == *b2, "failed check #4");
+		}
+	}
+	{
+		std::optional<DeserializerStream::ErrorType> error;
+		try{
+			DeserializerStream ds(serialized_a.data(), serialized_a.size() - 1);
+			ds.full_deserialization<A>(true);
+		}catch (DeserializationException &e){
+			error = e.get_type();
+		}
+		test_assertion(error.has_value() && *error == DeserializerStream::ErrorType::UnexpectedEndOfFile, "failed check #5");
+	}
+	{
+		//Streams that can't seek back aren't read past the end of the
+		//message.
+		UnseekableBuffer buffer(serialized_a + serialized_b + serialized_a);
+		std::istream stream(&buffer);
+		{
+			DeserializerStream ds(stream);
+			auto a2 = ds.full_deserialization<A>(true);
+			test_assertion(a == *a2, "failed check #6");
+		}
+		{
+			IstreamSource source(stream, 64);
+			DeserializerStream ds(source);
+			auto b2 = ds.full_deserialization<A>(true);
+			test_assertion(b == *b2, "failed check #7");
+		}
+		{
+			DeserializerStream ds(stream);
+			auto a2 = ds.full_deserialization<A>(true);
+			test_assertion(a == *a2, "failed check #8");
+		}
+	}
+	{
+		//A huge length followed by a few bytes fails at the end of the input
+		//instead of allocating the whole buffer up front.
+		std::string hostile;
+		{
+			StringSink sink(hostile);
+			SerializerStream ss(sink);
+			std::uint8_t padding[16] = {};
+			ss.serialize((wire_size_t)1 << 40);
+			ss.serialize_array(padding);
+		}
+		std::optional<DeserializerStream::ErrorType> error;
+		try{
+			std::stringstream stream(hostile);
+			DeserializerStream ds(stream);
+			buffer_view<std::uint8_t> view;
+			ds.deserialize(view);
+		}catch (DeserializationException &e){
+			error = e.get_type();
+		}
+		test_assertion(error.has_value() && *error == DeserializerStream::ErrorType::UnexpectedEndOfFile, "failed check #9");
+	}
+}
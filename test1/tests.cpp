@@ -12,6 +12,35 @@ void test4(std::uint32_t);
 void test5(std::uint32_t);
 void test6(std::uint32_t);
 void test7(std::uint32_t);
+void test8(std::uint32_t);
+void test9(std::uint32_t);
+void test10(std::uint32_t);
+void test11(std::uint32_t);
+void test12(std::uint32_t);
+void test13(std::uint32_t);
+void test14(std::uint32_t);
+void test15(std::uint32_t);
+void test16(std::uint32_t);
+void test17(std::uint32_t);
+void test18(std::uint32_t);
+void test19(std::uint32_t);
+void test20(std::uint32_t);
+void test21(std::uint32_t);
+void test22(std::uint32_t);
+void test23(std::uint32_t);
+void test24(std::uint32_t);
+void test25(std::uint32_t);
+void test26(std::uint32_t);
+void test27(std::uint32_t);
+void test28(std::uint32_t);
+void test29(std::uint32_t);
+void test30(std::uint32_t);
+
+void benchmark20(std::uint32_t);
+void benchmark26(std::uint32_t);
+void benchmark27(std::uint32_t);
+void benchmark28(std::uint32_t);
+void benchmark30(std::uint32_t);
 
 void run_tests(){
 	std::random_device dev;
@@ -23,6 +52,29 @@ void run_tests(){
 		test5,
 		test6,
 		test7,
+		test8,
+		test9,
+		test10,
+		test11,
+		test12,
+		test13,
+		test14,
+		test15,
+		test16,
+		test17,
+		test18,
+		test19,
+		test20,
+		test21,
+		test22,
+		test23,
+		test24,
+		test25,
+		test26,
+		test27,
+		test28,
+		test29,
+		test30,
 	};
 	size_t test_no = 0;
 	std::uint32_t seed = dev();
@@ -38,3 +90,23 @@ void run_tests(){
 	}
 	std::cout << "All tests passed.\n";
 }
+
+void run_benchmarks(){
+	std::random_device dev;
+	static const test_f benchmarks[] = {
+		benchmark20,
+		benchmark26,
+		benchmark27,
+		benchmark28,
+		benchmark30,
+	};
+	std::uint32_t seed = dev();
+	for (auto f : benchmarks){
+		try{
+			f(seed);
+		}catch (std::exception &e){
+			std::cerr << "Benchmark failed: " << e.what() << std::endl;
+			break;
+		}
+	}
+}
@@ -1,3 +1,5 @@
 #pragma once
 
 void run_tests();
+//Timings, which vary too much from run to run to be checked by the tests.
+void run_benchmarks();
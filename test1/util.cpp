@@ -1,10 +1,22 @@
 #include "util.hpp"
 
 std::string serialize(const Serializable &src){
-	std::stringstream temp;
-	SerializerStream ss(temp);
+	std::string ret;
+	StringSink sink(ret);
+	SerializerStream ss(sink);
 	ss.full_serialization(src, true);
-	return temp.str();
+	return ret;
+}
+
+std::string serialize(const Serializable &src, const SerializerStream::Options &options){
+	std::string ret;
+	StringSink sink(ret);
+	SerializerStream ss(sink);
+	auto size = ss.compute_serialized_size(src, options);
+	test_assertion(ss.full_serialization(src, options), "serialize(): full_serialization() failed");
+	sink.flush();
+	test_assertion(size && *size == ret.size(), "serialize(): compute_serialized_size() disagrees");
+	return ret;
 }
 
 void test_assertion(bool check, const char *message){
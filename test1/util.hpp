@@ -4,6 +4,7 @@
 #include <DeserializerStream.hpp>
 #include <optional>
 #include <sstream>
+#include <chrono>
 
 template <typename T>
 bool operator==(const std::optional<T> &l, const std::optional<T> &r){
@@ -20,17 +21,41 @@ bool operator!=(const std::optional<T> &l, const std::optional<T> &r){
 }
 
 std::string serialize(const Serializable &src);
+//Also checks that compute_serialized_size() agrees with the result.
+std::string serialize(const Serializable &src, const SerializerStream::Options &options);
 void test_assertion(bool check, const char *message);
 
 template <typename T>
 std::enable_if_t<std::is_base_of_v<Serializable, T>, std::unique_ptr<T>>
 deserialize(const std::string &src){
-	std::stringstream temp(src);
-	DeserializerStream eds(temp);
+	DeserializerStream eds(src.data(), src.size());
 	return eds.full_deserialization<T>(true);
 }
 
+template <typename T>
+std::enable_if_t<std::is_base_of_v<Serializable, T>, std::unique_ptr<T>>
+deserialize(const std::string &src, const DeserializerStream::Options &options){
+	DeserializerStream ds(src.data(), src.size());
+	return ds.full_deserialization<T>(options);
+}
+
 template <typename T>
 std::unique_ptr<T> round_trip(const T &src){
 	return deserialize<T>(serialize(src));
 }
+
+//Best of several runs, in seconds. check is called with every result.
+template <typename T, typename F>
+double time_deserialization(const std::string &serialized, const DeserializerStream::Options &options, const F &check){
+	double ret = -1;
+	for (int i = 0; i < 5; i++){
+		auto t0 = std::chrono::high_resolution_clock::now();
+		auto result = deserialize<T>(serialized, options);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		check(*result);
+		auto t = std::chrono::duration<double>(t1 - t0).count();
+		if (ret < 0 || t < ret)
+			ret = t;
+	}
+	return ret;
+}